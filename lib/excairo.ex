@@ -14,6 +14,47 @@ defmodule ExCairo do
     :ok = :erlang.load_nif(lib_path, 0)
   end
 
+  @doc """
+  Appends a path returned by `copy_path/1` or `copy_path_flat/1` to the
+  current path, so shapes can be built once and drawn many times
+  without re-issuing every `move_to/3` and `line_to/3`.
+  """
+  def append_path(_context, _path)
+  when
+    is_binary(_context) and
+    is_binary(_path)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Like `append_path/2`, with the path transformed by `transform`, either
+  a `{tx, ty}` translation, a matrix `{{xx, yx}, {xy, yy}, {x0, y0}}` or
+  a matrix resource. The current transformation matrix of the context
+  is left unchanged.
+  """
+  def append_path(_context, _path, _transform)
+  when
+    is_binary(_context) and
+    is_binary(_path) and
+    (is_tuple(_transform) or is_binary(_transform))
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Appends a path encoded by `path_to_binary/1` to the current path.
+  Returns `{:error, offset}` with the byte offset of the first
+  malformed element, in which case nothing is appended.
+  """
+  def append_path_binary(_context, _path)
+  when
+    is_binary(_context) and
+    is_binary(_path)
+  do
+    exit :library_not_loaded
+  end
+
   @doc """
   Adds a circular arc of the given radius to the current path. 
   The arc is centered at (xc, yc), begins at angle1 and proceeds 
@@ -138,6 +179,76 @@ defmodule ExCairo do
     exit :library_not_loaded
   end
 
+  @doc """
+  Compiles a batch of drawing operations (in any format accepted by
+  `ExCairo.execute`) into a native display list. The list can be
+  replayed against any context with `ExCairo.display_list_replay`
+  without decoding the operations again.
+
+  Returns `{:ok, display_list}` or `{:error, index}` for the first
+  malformed operation.
+  """
+  def display_list_compile(_ops) do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Replays a compiled display list against the context. Returns `:ok`
+  or `{:error, index}` for the first operation that put the context
+  into an error state.
+  """
+  def display_list_replay(_context, _display_list)
+  when
+    is_binary(_context) and
+    is_binary(_display_list)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Like `ExCairo.display_list_replay/2`, but the operations are drawn
+  under an additional transform `matrix` (`{{xx, yx}, {xy, yy}, {x0, y0}}`).
+  The transform of the context is restored afterwards.
+  """
+  def display_list_replay(_context, _display_list, _matrix)
+  when
+    is_binary(_context) and
+    is_binary(_display_list)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Applies a batch of drawing operations to the context in a single
+  native call. `ops` is either a list of operations like
+  `[{:move_to, x, y}, {:line_to, x, y}, :stroke]` or a packed binary
+  of `<<opcode::8, args::float-64...>>` records.
+
+  Supported operations (opcode, arguments): new_path (0), new_sub_path (1),
+  close_path (2), move_to (3, x, y), line_to (4, x, y), rel_move_to (5, dx, dy),
+  rel_line_to (6, dx, dy), curve_to (7, x1, y1, x2, y2, x3, y3),
+  rel_curve_to (8, dx1, dy1, dx2, dy2, dx3, dy3),
+  arc (9, xc, yc, radius, angle1, angle2), arc_negative (10, ...),
+  rectangle (11, x, y, width, height), stroke (12), stroke_preserve (13),
+  fill (14), fill_preserve (15), paint (16), paint_with_alpha (17, alpha),
+  clip (18), clip_preserve (19), reset_clip (20), save (21), restore (22),
+  translate (23, tx, ty), scale (24, sx, sy), rotate (25, radians),
+  set_source_rgb (26, r, g, b), set_source_rgba (27, r, g, b, a),
+  set_line_width (28, width), set_font_size (29, size).
+
+  Returns `:ok` or `{:error, index}` with the zero based index of the
+  first operation that was malformed or put the context into an error
+  state. All operations before it have been applied. An improper list
+  raises `ArgumentError` without applying anything. Large targets and
+  long batches are drawn on a dirty scheduler.
+  """
+  def execute(_context, _ops)
+  when
+    is_binary(_context)
+  do
+    exit :library_not_loaded
+  end
+
   @doc """
   TODO
   """
@@ -229,105 +340,1006 @@ defmodule ExCairo do
   end
 
   @doc """
-  Creates a bitmap in memory
+  Returns `{:ok, scaled_font}` for the scaled font currently used by
+  the context.
   """
-  def image_surface_create(_format, _width, _height) 
-  when 
-    is_atom(_format) 
+  def get_scaled_font(_context)
+  when
+    is_binary(_context)
   do
     exit :library_not_loaded
   end
 
   @doc """
-  Creates a new cairo context given a surface bitmap
+  Creates a new image surface and initializes the contents to the
+  given PNG file. Loading always runs on a dirty IO scheduler.
   """
-  def create(_surface) 
-  when 
-    is_binary(_surface) 
+  def image_surface_create_from_png(_file)
+  when
+    is_binary(_file)
   do
     exit :library_not_loaded
   end
 
   @doc """
-  Write a surface bitmap to a png file. This function
-  accepts elixir strings
+  Creates a new image surface from PNG data held in a binary, e.g. an
+  upload body. Returns `{:ok, surface}` or `{:error, status}` if the
+  data could not be decoded. Large inputs are decoded on a dirty CPU
+  scheduler.
   """
-  def surface_write_to_png(_surface, _file) 
-  when 
-    is_binary(_surface) and 
-    is_binary(_file) 
+  def image_surface_create_from_png_binary(_png)
+  when
+    is_binary(_png)
   do
     exit :library_not_loaded
   end
 
   @doc """
-  Select a font by specifying it's properties
+  Returns the pixel memory of an image surface as a binary of
+  `stride * height` bytes. The binary aliases the surface memory, so
+  no copy is made and the surface is kept alive as long as the binary
+  is referenced. Drawing to the surface afterwards changes the
+  contents of the binary; copy it with `:binary.copy/1` if a stable
+  snapshot is needed.
   """
-  def select_font_face(_context, _family, _slant, _weight) 
+  def image_surface_get_data(_surface)
+  when
+    is_binary(_surface)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Tests whether the point (x, y) is inside the area of the current clip.
+  """
+  def in_clip(_context, _x, _y)
   when
     is_binary(_context) and
-    is_binary(_family) and
-    is_atom(_slant) and
-    is_atom(_weight)
+    is_float(_x) and
+    is_float(_y)
   do
     exit :library_not_loaded
   end
 
   @doc """
-  Set the size of the currently selected font
+  Like `in_clip/3` for every point of a binary of
+  `<<x::float-64, y::float-64>>` points. Returns a bitset binary with
+  one bit per point, in order and padded with zeros to whole bytes, so
+  `for <<hit::1 <- bits>>` enumerates the results. Large batches yield
+  to the scheduler between chunks of points; the context stays locked
+  until the batch is done.
   """
-  def set_font_size(_context, _size) 
+  def in_clip_many(_context, _points)
   when
-    is_binary(_context)
+    is_binary(_context) and
+    is_binary(_points)
   do
     exit :library_not_loaded
   end
 
   @doc """
-  Sets the source pattern within cr to an opaque color. 
-  This opaque color will then be used for any subsequent 
-  drawing operation until a new source pattern is set
+  Tests whether the point (x, y) is inside the area that would be affected by `fill/1` with the current path and fill rule.
   """
-  def set_source_rgb(_context, _red, _green, _blue) 
+  def in_fill(_context, _x, _y)
   when
-    is_binary(_context)
+    is_binary(_context) and
+    is_float(_x) and
+    is_float(_y)
   do
     exit :library_not_loaded
   end
 
   @doc """
-  Begin a new sub-path. After this call the current point will be (x, y)
+  Like `in_fill/3` for every point of a binary of
+  `<<x::float-64, y::float-64>>` points. Returns a bitset binary with
+  one bit per point, in order and padded with zeros to whole bytes, so
+  `for <<hit::1 <- bits>>` enumerates the results. Large batches yield
+  to the scheduler between chunks of points; the context stays locked
+  until the batch is done.
   """
-  def move_to(_context, _x, _y) 
+  def in_fill_many(_context, _points)
   when
-    is_binary(_context)
+    is_binary(_context) and
+    is_binary(_points)
   do
     exit :library_not_loaded
   end
 
   @doc """
-   Adds a line to the path from the current point to position (x, y) 
-   in user-space coordinates. After this call the current point will be (x, y). 
+  Tests whether the point (x, y) is inside the area that would be affected by `stroke/1` with the current path and stroke parameters.
   """
-  def line_to(_context, _x, _y) 
+  def in_stroke(_context, _x, _y)
   when
-    is_binary(_context)
+    is_binary(_context) and
+    is_float(_x) and
+    is_float(_y)
   do
     exit :library_not_loaded
   end
 
   @doc """
-  A drawing operator that generates the shape from a string of UTF-8 characters, 
-  rendered according to the current font_face, font_size (font_matrix), 
-  and font_options.
+  Like `in_stroke/3` for every point of a binary of
+  `<<x::float-64, y::float-64>>` points. Returns a bitset binary with
+  one bit per point, in order and padded with zeros to whole bytes, so
+  `for <<hit::1 <- bits>>` enumerates the results. Large batches yield
+  to the scheduler between chunks of points; the context stays locked
+  until the batch is done.
   """
-  def show_text(_context, _text) 
+  def in_stroke_many(_context, _points)
+  when
+    is_binary(_context) and
+    is_binary(_points)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  A drawing operator that paints the current source using the alpha
+  channel of surface as a mask. Runs on a dirty CPU scheduler when the
+  target surface is large.
+  """
+  def mask_surface(_context, _surface, _surface_x, _surface_y)
+  when
+    is_binary(_context) and
+    is_binary(_surface)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Creates a matrix resource for the affine transformation given by
+  `xx`, `yx`, `xy`, `yy`, `x0` and `y0`. Matrix resources are modified
+  in place by `matrix_translate/3`, `matrix_scale/3`, `matrix_rotate/2`,
+  `matrix_multiply/2` and `matrix_invert/1`, and are accepted wherever a
+  `{{xx, yx}, {xy, yy}, {x0, y0}}` matrix tuple is.
+  """
+  def matrix_init(_xx, _yx, _xy, _yy, _x0, _y0)
+  when
+    is_number(_xx) and
+    is_number(_yx) and
+    is_number(_xy) and
+    is_number(_yy) and
+    is_number(_x0) and
+    is_number(_y0)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Creates an identity matrix resource.
+  """
+  def matrix_init_identity() do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Creates a matrix resource rotating by `radians`.
+  """
+  def matrix_init_rotate(_radians)
+  when
+    is_number(_radians)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Creates a matrix resource scaling by `sx` and `sy`.
+  """
+  def matrix_init_scale(_sx, _sy)
+  when
+    is_number(_sx) and
+    is_number(_sy)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Creates a matrix resource translating by `tx` and `ty`.
+  """
+  def matrix_init_translate(_tx, _ty)
+  when
+    is_number(_tx) and
+    is_number(_ty)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Inverts a matrix resource in place. Returns `{:error, :invalid_matrix}`
+  and leaves the matrix unchanged if it has no inverse.
+  """
+  def matrix_invert(_matrix)
+  when
+    is_binary(_matrix)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Multiplies a matrix resource by `other` in place, so that it applies
+  its previous transformation first and then `other`. `other` may be a
+  matrix resource or a matrix tuple.
+  """
+  def matrix_multiply(_matrix, _other)
+  when
+    is_binary(_matrix)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Applies a rotation by `radians` to a matrix resource in place. The
+  rotation happens before the existing transformation.
+  """
+  def matrix_rotate(_matrix, _radians)
+  when
+    is_binary(_matrix) and
+    is_number(_radians)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Applies a scale by `sx` and `sy` to a matrix resource in place. The
+  scale happens before the existing transformation.
+  """
+  def matrix_scale(_matrix, _sx, _sy)
+  when
+    is_binary(_matrix) and
+    is_number(_sx) and
+    is_number(_sy)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Returns a matrix resource as a `{{xx, yx}, {xy, yy}, {x0, y0}}` tuple.
+  """
+  def matrix_to_tuple(_matrix)
+  when
+    is_binary(_matrix)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Transforms the distance vector `{dx, dy}` by a matrix, ignoring the
+  translation. Returns `{dx, dy}`.
+  """
+  def matrix_transform_distance(_matrix, _dx, _dy)
+  when
+    is_number(_dx) and
+    is_number(_dy)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Transforms the point `{x, y}` by a matrix. Returns `{x, y}`.
+  """
+  def matrix_transform_point(_matrix, _x, _y)
+  when
+    is_number(_x) and
+    is_number(_y)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Transforms a binary of `<<x::float-64, y::float-64>>` points by a
+  matrix in one call and returns the transformed points in the same
+  format. Runs on a dirty CPU scheduler for large inputs.
+  """
+  def matrix_transform_points(_matrix, _points)
+  when
+    is_binary(_points)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Applies a translation by `tx` and `ty` to a matrix resource in place.
+  The translation happens before the existing transformation.
+  """
+  def matrix_translate(_matrix, _tx, _ty)
+  when
+    is_binary(_matrix) and
+    is_number(_tx) and
+    is_number(_ty)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  A drawing operator that paints the current source everywhere within
+  the current clip region. Runs on a dirty CPU scheduler when the
+  target surface is large.
+  """
+  def paint(_context)
   when
     is_binary(_context)
   do
     exit :library_not_loaded
   end
 
+  @doc """
+  Encodes a path returned by `copy_path/1` or `copy_path_flat/1` as a
+  binary of `<<op::8, points::float-64...>>` elements that can be stored
+  or sent to other nodes. `op` is 0 for move_to (1 point), 1 for
+  line_to (1 point), 2 for curve_to (3 points) and 3 for close_path.
+  """
+  def path_to_binary(_path)
+  when
+    is_binary(_path)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Starts a new sub-path at the first point of `points` and adds a line
+  to every following point. `points` is a packed binary of
+  `<<x::float-64, y::float-64, ...>>`. Large inputs yield to other
+  processes while they are being added; the context stays locked until
+  the last point is in and other calls on it return `{:error, :busy}`.
+  """
+  def polyline(_context, _points)
+  when
+    is_binary(_context) and
+    is_binary(_points)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Like `ExCairo.polyline`, but closes the sub-path after the last point.
+  """
+  def polygon(_context, _points)
+  when
+    is_binary(_context) and
+    is_binary(_points)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Creates a bitmap in memory
+  """
+  def image_surface_create(_format, _width, _height) 
+  when 
+    is_atom(_format) 
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Creates an image surface initialized with the raw pixels in `data`,
+  laid out as `height` rows of `stride` bytes in the given format.
+  The pixels are copied once into memory owned by the surface, so the
+  binary may be discarded afterwards. Large images are copied on a
+  dirty CPU scheduler.
+  """
+  def image_surface_create_for_data(_data, _format, _width, _height, _stride)
+  when
+    is_binary(_data) and
+    is_atom(_format)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Creates a new cairo context given a surface bitmap
+
+  Drawing through the context locks the surface as well, so painting
+  returns `{:error, :busy}` while the surface is being encoded, read
+  or drawn on through another context.
+  """
+  def create(_surface) 
+  when 
+    is_binary(_surface) 
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Compares an image surface with `previous`, a snapshot of the last
+  frame of the same format and size, in square tiles of `tile_size`
+  pixels. Returns `{:ok, [{x, y, width, height, data}]}` with the tiles
+  that changed, in row-major order. `data` is a PNG when `encoding` is
+  `:png`, or the rows of the tile in the pixel format of the surface
+  when it is `:raw`. `previous` is updated in place to match the
+  surface, so it can be passed again with the next frame. Runs on a
+  dirty CPU scheduler when the surface is large.
+  """
+  def surface_diff_tiles(_surface, _previous, _tile_size, _encoding)
+  when
+    is_binary(_surface) and
+    is_binary(_previous) and
+    is_integer(_tile_size) and
+    is_atom(_encoding)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Tells cairo that the rectangle of the surface was changed by drawing
+  outside of cairo. The rectangle is also added to the damage of the
+  surface when `surface_track_damage/2` is enabled.
+  """
+  def surface_mark_dirty_rectangle(_surface, _x, _y, _width, _height)
+  when
+    is_binary(_surface) and
+    is_integer(_x) and
+    is_integer(_y) and
+    is_integer(_width) and
+    is_integer(_height)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Destroys all surfaces currently held by the surface pool. The caps
+  set with `ExCairo.surface_pool_set_cap` stay in place.
+  """
+  def surface_pool_clear() do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Keeps up to `cap` collected image surfaces of the given format and
+  size for reuse by `ExCairo.image_surface_create`. A reused surface is
+  cleared when it is handed out. The default cap of every shape is 0,
+  which disables pooling for it.
+  """
+  def surface_pool_set_cap(_format, _width, _height, _cap)
+  when
+    is_atom(_format)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Returns the state of the surface pool as a list of
+  `{format, width, height, cap, pooled, hits, misses}` tuples, one per
+  configured shape.
+  """
+  def surface_pool_stats() do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Returns `{:ok, snapshot}` with a copy of an image surface, e.g. to
+  keep the previous frame for `surface_diff_tiles/4`.
+  """
+  def surface_snapshot(_surface)
+  when
+    is_binary(_surface)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Encodes a surface as PNG on a native worker thread and streams the
+  output to `pid` while it is produced, as
+  `{:excairo_png_chunk, ref, chunk}` messages of up to 64 KiB, followed
+  by `{:excairo_png_done, ref, result}` where result is `:ok` or
+  `{:error, status}`. Returns `:ok` right away, or `{:error, :busy}` if
+  the surface is in use; it stays locked until the encode is done.
+  """
+  def surface_stream_png(_surface, _pid, _ref)
+  when
+    is_binary(_surface) and
+    is_pid(_pid)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Returns `{:ok, region}` with the device space area of the surface
+  drawn to since damage tracking was enabled or since the last call,
+  and starts over with an empty region. Returns `{:error, :not_tracked}`
+  if damage tracking is disabled.
+  """
+  def surface_take_damage(_surface)
+  when
+    is_binary(_surface)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Enables or disables damage tracking for a surface. While enabled,
+  `fill`, `stroke`, `paint`, `mask`, `show_text` and `show_glyphs` on any
+  context targeting the surface add the bounds of what they draw to its
+  damage, as do display lists and `surface_mark_dirty_rectangle/5`. Other
+  changes must be reported with `surface_mark_dirty_rectangle/5`.
+  """
+  def surface_track_damage(_surface, _enable)
+  when
+    is_binary(_surface) and
+    is_boolean(_enable)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Write a surface bitmap to a png file. This function
+  accepts elixir strings
+  """
+  def surface_write_to_png(_surface, _file) 
+  when 
+    is_binary(_surface) and 
+    is_binary(_file) 
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Encodes a surface bitmap as PNG in memory. Returns `{:ok, png}` with
+  the encoded image as a binary, or `{:error, status}`. Large surfaces
+  are encoded on a dirty CPU scheduler.
+  """
+  def surface_write_to_png_binary(_surface)
+  when
+    is_binary(_surface)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Creates a scaled font from a font face, a font matrix and a user to
+  device matrix (both `{{xx, yx}, {xy, yy}, {x0, y0}}`). Default font
+  options are used. A scaled font can be shared by any number of
+  contexts and processes.
+  """
+  def scaled_font_create(_font_face, _font_matrix, _ctm)
+  when
+    is_binary(_font_face)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Like `ExCairo.scaled_font_create/3` with explicit font options.
+  """
+  def scaled_font_create(_font_face, _font_matrix, _ctm, _font_options)
+  when
+    is_binary(_font_face) and
+    is_binary(_font_options)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Select a font by specifying it's properties
+  """
+  def select_font_face(_context, _family, _slant, _weight) 
+  when
+    is_binary(_context) and
+    is_binary(_family) and
+    is_atom(_slant) and
+    is_atom(_weight)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Replaces the font face, font matrix and font options of the context
+  with those of a scaled font.
+  """
+  def set_scaled_font(_context, _scaled_font)
+  when
+    is_binary(_context) and
+    is_binary(_scaled_font)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Set the size of the currently selected font
+  """
+  def set_font_size(_context, _size) 
+  when
+    is_binary(_context)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Sets the source pattern within cr to an opaque color. 
+  This opaque color will then be used for any subsequent 
+  drawing operation until a new source pattern is set
+  """
+  def set_source_rgb(_context, _red, _green, _blue) 
+  when
+    is_binary(_context)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Begin a new sub-path. After this call the current point will be (x, y)
+  """
+  def move_to(_context, _x, _y) 
+  when
+    is_binary(_context)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+   Adds a line to the path from the current point to position (x, y) 
+   in user-space coordinates. After this call the current point will be (x, y). 
+  """
+  def line_to(_context, _x, _y) 
+  when
+    is_binary(_context)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Drops all entries of the raster cache.
+  """
+  def raster_cache_clear() do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Sets the maximum number of pixel bytes the raster cache holds. When
+  the cache is full, the least recently used entries are evicted. The
+  default of 0 disables the cache.
+  """
+  def raster_cache_configure(_max_bytes)
+  when
+    is_integer(_max_bytes)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Rasterizes a recording surface under `matrix`
+  (`{{xx, yx}, {xy, yy}, {x0, y0}}`) into a new image surface of the
+  given format and size. The result is cached by recording, matrix,
+  size and format. A later call with the same key copies the cached
+  pixels instead of replaying the recording. Each call returns its
+  own surface, so drawing on the result never changes the cache.
+
+  Cached entries are dropped when the recording is destroyed or drawn
+  to again through a context.
+  """
+  def raster_cache_render(_recording, _matrix, _format, _width, _height)
+  when
+    is_binary(_recording) and
+    is_atom(_format)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Returns the state of the raster cache as
+  `{entries, bytes, max_bytes, hits, misses}`.
+  """
+  def raster_cache_stats() do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Creates a recording surface that records drawing for later replay.
+  `content` is `:color`, `:alpha` or `:color_alpha` and `extents` is
+  a `{x, y, width, height}` tuple of floats.
+  """
+  def recording_surface_create(_content, _extents)
+  when
+    is_atom(_content) and
+    is_tuple(_extents)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Renders a recording surface into a z/x/y tile pyramid. Every tile is
+  `tile_size` pixels square and PNG encoded. Zoom levels run from
+  `min_zoom` to `max_zoom` (at most 20). At zoom `z` the longer side of
+  the recording extents spans `2^z` tiles. Unbounded recordings are
+  tiled by their ink extents. Tiles are rendered in parallel on the
+  native worker pool. A single call renders at most 262144 tiles over
+  all zoom levels.
+
+  Returns `{:ok, [{z, x, y, png}]}` once all tiles are done, or
+  `{:error, status}` if the recording is empty or rendering failed.
+  """
+  def recording_surface_render_tiles(_recording, _tile_size, _min_zoom, _max_zoom)
+  when
+    is_binary(_recording)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Like `ExCairo.recording_surface_render_tiles/4`, but returns
+  `{:ok, ref}` right away and sends every tile to `pid` as
+  `{:excairo_tile, ref, {z, x, y}, png}` as soon as it is encoded.
+  Tiles can arrive in any order. The last message is
+  `{:excairo_tiles_done, ref, result}`, where result is `:ok` or
+  `{:error, status}`. The recording surface stays locked until then.
+  If `pid` has exited, the remaining tiles are skipped.
+  """
+  def recording_surface_render_tiles(_recording, _tile_size, _min_zoom, _max_zoom, _pid)
+  when
+    is_binary(_recording) and
+    is_pid(_pid)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Applies a batch of drawing operations (see `ExCairo.execute`) on a
+  native worker thread instead of a scheduler. `context` must target
+  `surface`; both are kept alive until the job has finished.
+
+  Returns `{:ok, ref}` right away. When the job is done the calling
+  process receives `{:excairo_done, ref, result}` where result is
+  `:ok` or `{:error, index}`. A malformed batch is rejected immediately
+  with `{:error, index}`.
+
+  The context and the surface stay locked until the job has finished;
+  any other call using them in the meantime returns `{:error, :busy}`.
+  """
+  def render_async(_surface, _context, _ops)
+  when
+    is_binary(_surface) and
+    is_binary(_context)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Draws a recording surface or a compiled display list into a new
+  image surface of the given format and size. The image is split into
+  horizontal bands, and each band is drawn on a native worker thread
+  with its own context, straight into the pixels of the result. A
+  recording is painted with its origin at the top left corner.
+
+  Returns `{:ok, surface}`. On failure it returns
+  `{:error, {:op, index}}` for the first failing display list
+  operation, or `{:error, {:status, status}}` with the cairo status
+  otherwise.
+  """
+  def render_bands(_source, _format, _width, _height)
+  when
+    is_binary(_source) and
+    is_atom(_format)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Checks whether the point (x, y) is contained in the region.
+  """
+  def region_contains_point(_region, _x, _y)
+  when
+    is_binary(_region) and
+    is_integer(_x) and
+    is_integer(_y)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Checks whether the rectangle `{x, y, width, height}` is inside,
+  outside or partially contained in the region. Returns `:in`, `:out`
+  or `:part`.
+  """
+  def region_contains_rectangle(_region, _rectangle)
+  when
+    is_binary(_region) and
+    is_tuple(_rectangle)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Returns `{:ok, region}` with a copy of the region.
+  """
+  def region_copy(_region)
+  when
+    is_binary(_region)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Returns `{:ok, region}` with a new empty region.
+  """
+  def region_create() do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Returns `{:ok, region}` with the union of the rectangles in a binary of
+  `<<x::32-signed, y::32-signed, width::32-signed, height::32-signed>>`
+  records.
+  """
+  def region_create_rectangles(_rectangles)
+  when
+    is_binary(_rectangles)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Checks whether two regions cover the same area.
+  """
+  def region_equal(_a, _b)
+  when
+    is_binary(_a) and
+    is_binary(_b)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Returns the bounding box of the region as `{x, y, width, height}`.
+  """
+  def region_get_extents(_region)
+  when
+    is_binary(_region)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Returns the rectangles of the region as a binary in the format taken
+  by `region_create_rectangles/1`.
+  """
+  def region_get_rectangles(_region)
+  when
+    is_binary(_region)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Intersects the region in place with `other`, which is a region or a
+  binary of packed rectangles. Returns `:ok` or `{:error, status}`.
+  """
+  def region_intersect(_region, _other)
+  when
+    is_binary(_region) and
+    is_binary(_other)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Checks whether the region is empty.
+  """
+  def region_is_empty(_region)
+  when
+    is_binary(_region)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Returns the number of rectangles the region is made of.
+  """
+  def region_num_rectangles(_region)
+  when
+    is_binary(_region)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Subtracts `other`, a region or a binary of packed rectangles, from
+  the region in place. Returns `:ok` or `{:error, status}`.
+  """
+  def region_subtract(_region, _other)
+  when
+    is_binary(_region) and
+    is_binary(_other)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Translates the region in place by (dx, dy).
+  """
+  def region_translate(_region, _dx, _dy)
+  when
+    is_binary(_region) and
+    is_integer(_dx) and
+    is_integer(_dy)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Adds `other`, a region or a binary of packed rectangles, to the
+  region in place. Returns `:ok` or `{:error, status}`.
+  """
+  def region_union(_region, _other)
+  when
+    is_binary(_region) and
+    is_binary(_other)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Replaces the region in place with the area covered by exactly one of
+  the region and `other`, a region or a binary of packed rectangles.
+  Returns `:ok` or `{:error, status}`.
+  """
+  def region_xor(_region, _other)
+  when
+    is_binary(_region) and
+    is_binary(_other)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  A drawing operator that draws glyphs with the current font. `glyphs`
+  is a packed binary of `<<index::32, x::float-64, y::float-64>>`
+  records, e.g. as returned by `ExCairo.text_to_glyphs`.
+  """
+  def show_glyphs(_context, _glyphs)
+  when
+    is_binary(_context) and
+    is_binary(_glyphs)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  A drawing operator that generates the shape from a string of UTF-8 characters,
+  rendered according to the current font_face, font_size (font_matrix), 
+  and font_options.
+
+  Returns `:ok`, or `{:error, status}` with the cairo status if the
+  text could not be shown, for example because it is not valid UTF-8.
+  """
+  def show_text(_context, _text) 
+  when
+    is_binary(_context)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Measures every binary in `texts` in one call, using the font selected
+  on a context or a scaled font. Returns a packed binary with one
+  `<<x_bearing::float-64, y_bearing::float-64, width::float-64,
+  height::float-64, x_advance::float-64, y_advance::float-64>>` record
+  per string, in list order. Returns `{:error, {index, status}}` with
+  the cairo status for the first string that could not be shaped, e.g.
+  one that is not valid UTF-8. Long lists are measured on a dirty CPU
+  scheduler.
+  """
+  def text_extents_many(_context_or_scaled_font, _texts)
+  when
+    is_binary(_context_or_scaled_font) and
+    is_list(_texts)
+  do
+    exit :library_not_loaded
+  end
+
+  @doc """
+  Converts UTF-8 text to glyphs of a scaled font, positioned starting
+  at (x, y). Returns `{:ok, glyphs}`, where glyphs is a packed binary
+  of `<<index::32, x::float-64, y::float-64>>` records that can be
+  passed to `ExCairo.show_glyphs` any number of times.
+  """
+  def text_to_glyphs(_scaled_font, _x, _y, _text)
+  when
+    is_binary(_scaled_font) and
+    is_binary(_text)
+  do
+    exit :library_not_loaded
+  end
+
   @doc """
   A drawing operator that strokes the current path according to the current 
   line width, line join, line cap, and dash settings
@@ -70,6 +70,9 @@ static void define_predef_atoms (ErlNifEnv *env) {
     ET_color            = enif_make_atom(env, "color");
     ET_alpha            = enif_make_atom(env, "alpha");
     ET_color_alpha      = enif_make_atom(env, "color_alpha");
+
+    ET_png              = enif_make_atom(env, "png");
+    ET_raw              = enif_make_atom(env, "raw");
 }
 
 /**
@@ -110,6 +113,14 @@ static int load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info) {
              gc_cairo_path_t,
              ERL_NIF_RT_CREATE, NULL);
 
+    // Define display_list_t_TYPE
+    display_list_t_RT = enif_open_resource_type(
+             env,
+             NULL,
+             "display_list_t_TYPE",
+             gc_display_list_t,
+             ERL_NIF_RT_CREATE, NULL);
+
     // Define cairo_font_face_t_TYPE
     cairo_font_face_t_RT = enif_open_resource_type(
              env,
@@ -126,6 +137,22 @@ static int load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info) {
              gc_cairo_font_options_t,
              ERL_NIF_RT_CREATE, NULL);
 
+    // Define cairo_scaled_font_t_TYPE
+    cairo_scaled_font_t_RT = enif_open_resource_type(
+             env,
+             NULL,
+             "cairo_scaled_font_t_TYPE",
+             gc_cairo_scaled_font_t,
+             ERL_NIF_RT_CREATE, NULL);
+
+    // Define cairo_matrix_t_TYPE
+    cairo_matrix_t_RT = enif_open_resource_type(
+             env,
+             NULL,
+             "cairo_matrix_t_TYPE",
+             NULL,
+             ERL_NIF_RT_CREATE, NULL);
+
     // Define cairo_pattern_t_TYPE
     cairo_pattern_t_RT = enif_open_resource_type(
              env,
@@ -142,6 +169,22 @@ static int load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info) {
              gc_cairo_region_t,
              ERL_NIF_RT_CREATE, NULL);
 
+    // Define hit_test_t
+    hit_test_t_RT = enif_open_resource_type(
+             env,
+             NULL,
+             "hit_test_t",
+             gc_hit_test_t,
+             ERL_NIF_RT_CREATE, NULL);
+
+    // Define points_path_t
+    points_path_t_RT = enif_open_resource_type(
+             env,
+             NULL,
+             "points_path_t",
+             gc_points_path_t,
+             ERL_NIF_RT_CREATE, NULL);
+
     // Define cairo_t_TYPE
     cairo_t_RT = enif_open_resource_type(
              env,
@@ -153,19 +196,137 @@ static int load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info) {
     // Assert that all definitions were successful
     ERL_ASSERT_LOAD(cairo_surface_t_RT);
     ERL_ASSERT_LOAD(cairo_path_t_RT);
+    ERL_ASSERT_LOAD(display_list_t_RT);
     ERL_ASSERT_LOAD(cairo_font_face_t_RT);
     ERL_ASSERT_LOAD(cairo_font_options_t_RT);
+    ERL_ASSERT_LOAD(cairo_scaled_font_t_RT);
+    ERL_ASSERT_LOAD(cairo_matrix_t_RT);
     ERL_ASSERT_LOAD(cairo_pattern_t_RT);
     ERL_ASSERT_LOAD(cairo_region_t_RT);
+    ERL_ASSERT_LOAD(hit_test_t_RT);
+    ERL_ASSERT_LOAD(points_path_t_RT);
     ERL_ASSERT_LOAD(cairo_t_RT);
 
     // Initialize the predefined erlang terms
     define_predef_atoms(env);
+    define_op_atoms(env);
+
+    // Start one native worker per scheduler for asynchronous jobs
+    ErlNifSysInfo info;
+    enif_system_info(&info, sizeof(ErlNifSysInfo));
+    ERL_ASSERT_LOAD(pool_start(info.scheduler_threads > 0 ? info.scheduler_threads : 1));
+
+    // Surface recycling, disabled until a cap is configured, rasterized
+    // recordings, disabled until a size limit is configured, and per
+    // thread copies of string arguments
+    if (!surface_pool_init() || !raster_cache_init() || !scratch_init()) {
+        // Undo in reverse order, the pool threads are already running
+        scratch_destroy();
+        raster_cache_destroy();
+        surface_pool_destroy();
+        pool_stop();
+        return -1;
+    }
 
     // Return success
     return 0;
 }
 
+/**
+ * NIF teardown. Waits for queued asynchronous jobs to finish and
+ * frees all pooled and cached surfaces and the scratch buffers.
+ * @brief unload
+ * @param env Erlang environment
+ * @param priv
+ */
+static void unload(ErlNifEnv *env, void *priv) {
+    pool_stop();
+    raster_cache_destroy();
+    surface_pool_destroy();
+    scratch_destroy();
+}
+
+/**
+ * Wraps cairo_append_path(cairo_t *cr, const cairo_path_t *path)
+ * -> The path is a resource returned by copy_path or copy_path_flat
+ * -> An optional third argument transforms the appended path, either
+ * a {tx, ty} translation or a matrix. The transform does not change
+ * the current transformation matrix of the context.
+ * @brief EX_append_path
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_append_path(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT(argc == 2 || argc == 3);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+
+    ERL_GET_INSTANCE(cairo_path_t_TYPE, cairo_path_t_RT, 1, path);
+    ERL_ASSERT(path && path->data);
+    ERL_ASSERT(path->data->status == CAIRO_STATUS_SUCCESS);
+
+    if (argc == 3) {
+        int arity;
+        const ERL_NIF_TERM *transform;
+        cairo_matrix_t matrix;
+        if (enif_get_tuple(env, argv[2], &arity, &transform) && arity == 2) {
+            double tx, ty;
+            ERL_ASSERT(get_number(env, transform[0], &tx) && get_number(env, transform[1], &ty));
+            cairo_matrix_init_translate(&matrix, tx, ty);
+        } else {
+            ERL_IMPORT_MATRIX(2, imported);
+            matrix = imported;
+        }
+
+        // The path is transformed while it is appended, so the matrix
+        // is restored right afterwards
+        cairo_save(context->data);
+        cairo_transform(context->data, &matrix);
+        cairo_append_path(context->data, path->data);
+        cairo_restore(context->data);
+    } else {
+        cairo_append_path(context->data, path->data);
+    }
+
+    return ERL_OK;
+}
+
+/**
+ * Wraps cairo_append_path(cairo_t *cr, const cairo_path_t *path)
+ * -> The path is a packed binary of <<op::8, points::float-64...>>
+ * elements as produced by path_to_binary
+ * -> Returns :ok or {:error, offset} with the byte offset of the
+ * first malformed element, in which case nothing is appended
+ * @brief EX_append_path_binary
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_append_path_binary(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+
+    ErlNifBinary bin;
+    ERL_ASSERT(enif_inspect_binary(env, argv[1], &bin));
+
+    cairo_path_t path;
+    size_t failed;
+    if (!read_packed_path(&bin, &path, &failed)) {
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_uint64(env, failed));
+    }
+
+    cairo_append_path(context->data, &path);
+    enif_free(path.data);
+
+    return ERL_OK;
+}
+
 /**
  * Wraps cairo_arc(cairo_t *cr, double xc, double yc, double radius, double angle1, double angle2)
  * @brief EX_arc
@@ -178,6 +339,7 @@ static ERL_NIF_TERM EX_arc(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
     ERL_ASSERT_ARGC(6);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double xc, yc, radius, angle1, angle2;
     enif_get_double(env, argv[1], &xc);
@@ -202,6 +364,7 @@ static ERL_NIF_TERM EX_arc_negative(ErlNifEnv* env, int argc, const ERL_NIF_TERM
     ERL_ASSERT_ARGC(6);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double xc, yc, radius, angle1, angle2;
     enif_get_double(env, argv[1], &xc);
@@ -226,6 +389,7 @@ static ERL_NIF_TERM EX_clip(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_clip(context->data);
 
@@ -246,6 +410,7 @@ static ERL_NIF_TERM EX_clip_extents(ErlNifEnv* env, int argc, const ERL_NIF_TERM
     ERL_ASSERT_ARGC(5);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double x1, y1, x2, y2;
     enif_get_double(env, argv[1], &x1);
@@ -274,6 +439,7 @@ static ERL_NIF_TERM EX_clip_preserve(ErlNifEnv* env, int argc, const ERL_NIF_TER
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_clip_preserve(context->data);
 
@@ -292,6 +458,7 @@ static ERL_NIF_TERM EX_close_path(ErlNifEnv* env, int argc, const ERL_NIF_TERM a
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_close_path(context->data);
 
@@ -312,6 +479,7 @@ static ERL_NIF_TERM EX_copy_clip_rectangle_list(ErlNifEnv* env, int argc, const
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_rectangle_list_t *rects = cairo_copy_clip_rectangle_list(context->data);
     /**
@@ -362,6 +530,8 @@ static ERL_NIF_TERM EX_copy_page(ErlNifEnv* env, int argc, const ERL_NIF_TERM ar
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
 
     cairo_copy_page(context->data);
 
@@ -380,6 +550,7 @@ static ERL_NIF_TERM EX_copy_path(ErlNifEnv* env, int argc, const ERL_NIF_TERM ar
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     ERL_MAKE_INSTANCE(cairo_path_t_TYPE, cairo_path_t_RT, instance);
     ERL_ASSERT(instance);
@@ -403,6 +574,7 @@ static ERL_NIF_TERM EX_copy_path_flat(ErlNifEnv* env, int argc, const ERL_NIF_TE
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     ERL_MAKE_INSTANCE(cairo_path_t_TYPE, cairo_path_t_RT, instance);
     ERL_ASSERT(instance);
@@ -433,6 +605,7 @@ static ERL_NIF_TERM EX_curve_to(ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
     ERL_ASSERT_ARGC(7);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double x1, y1, x2, y2, x3, y3;
     enif_get_double(env, argv[1], &x1);
@@ -447,27 +620,237 @@ static ERL_NIF_TERM EX_curve_to(ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
     return ERL_OK;
 }
 
+/**
+ * Compiles a batch of draw operations (see EX_execute) into a
+ * display list resource that can be replayed many times
+ * -> Returns {:ok, display_list} or {:error, index} for the first
+ * malformed operation
+ * @brief EX_display_list_compile
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_display_list_compile(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+
+    draw_op_t *ops;
+    size_t count;
+    int failed;
+    if (!decode_ops(env, argv[0], &ops, &count, &failed)) {
+        ERL_ASSERT(failed >= 0);
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, failed));
+    }
+
+    ERL_MAKE_INSTANCE(display_list_t_TYPE, display_list_t_RT, instance);
+    if (!instance) {
+        enif_free(ops);
+        return enif_make_badarg(env);
+    }
+
+    instance->ops = ops;
+    instance->count = count;
+
+    // Create a garbage-collectable resource
+    ERL_MAKE_GC_RES(instance, list);
+    return ERL_MAKE_OK_TUPLE(list);
+}
+
+/**
+ * Replays a display list, optionally under an additional transform
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_display_list_replay_dirty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_display_list_replay_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT(argc == 2 || argc == 3);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
+
+    ERL_GET_INSTANCE(display_list_t_TYPE, display_list_t_RT, 1, list);
+    ERL_ASSERT(list);
+
+    int failed;
+    if (argc == 3) {
+        ERL_IMPORT_MATRIX(2, matrix);
+
+        // The transform only applies to the replayed operations
+        cairo_save(context->data);
+        cairo_transform(context->data, &matrix);
+        failed = apply_ops(context->data, list->ops, list->count);
+        cairo_restore(context->data);
+    } else {
+        failed = apply_ops(context->data, list->ops, list->count);
+    }
+
+    if (failed >= 0) {
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, failed));
+    }
+
+    return ERL_OK;
+}
+
+/**
+ * Replays a display list, optionally under an additional transform
+ * -> Returns :ok or {:error, index} for the first operation that put
+ * the context into an error state
+ * -> Moves to a dirty CPU scheduler if the target surface is large
+ * @brief EX_display_list_replay
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_display_list_replay(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT(argc == 2 || argc == 3);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+
+    ERL_SCHEDULE_DIRTY_IF(SURFACE_AREA(cairo_get_group_target(context->data)) > DIRTY_AREA_THRESHOLD,
+                          "display_list_replay", ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_display_list_replay_dirty);
+
+    return EX_display_list_replay_dirty(env, argc, argv);
+}
+
 // TODO (?)
 // Devices
 
+/**
+ * Applies a batch of draw operations to a context in a single call.
+ * -> The operations are either given as a list of tuples, e.g.
+ * [{:move_to, x, y}, {:line_to, x, y}, :stroke], or as a packed binary
+ * of <<opcode::8, args::float-64...>> records (see draw_op_code_t).
+ * Returns :ok or {:error, index} where index is the (zero based)
+ * position of the first operation that could not be decoded or left
+ * the context in an error state. Operations before index have been
+ * applied.
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_execute_dirty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_execute_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
+
+    draw_op_t op;
+    int index = 0;
+
+    ErlNifBinary bin;
+    if (enif_inspect_binary(env, argv[1], &bin)) {
+        size_t offset = 0;
+        while (offset < bin.size) {
+            if (!decode_op_packed(&bin, &offset, &op) ||
+                    apply_op(context->data, &op) != CAIRO_STATUS_SUCCESS) {
+                return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, index));
+            }
+            index++;
+        }
+        return ERL_OK;
+    }
+
+    ERL_ASSERT(enif_is_list(env, argv[1]));
+
+    ERL_NIF_TERM head, tail = argv[1];
+    while (enif_get_list_cell(env, tail, &head, &tail)) {
+        if (!decode_op_term(env, head, &op) ||
+                apply_op(context->data, &op) != CAIRO_STATUS_SUCCESS) {
+            return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, index));
+        }
+        index++;
+    }
+
+    return ERL_OK;
+}
+
+/**
+ * Applies a batch of draw operations to a context in a single call.
+ * -> Moves to a dirty CPU scheduler if the target surface is large or
+ * the batch holds many operations. Improper lists are rejected before
+ * any operation is applied.
+ * @brief EX_execute
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_execute(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+
+    size_t length;
+    ErlNifBinary bin;
+    if (enif_inspect_binary(env, argv[1], &bin)) {
+        length = bin.size / sizeof(double);
+    } else {
+        unsigned list_length;
+        ERL_ASSERT(enif_get_list_length(env, argv[1], &list_length));
+        length = list_length;
+    }
+
+    ERL_SCHEDULE_DIRTY_IF(length > ITEMS_PER_CHUNK ||
+                          SURFACE_AREA(cairo_get_group_target(context->data)) > DIRTY_AREA_THRESHOLD,
+                          "execute", ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_execute_dirty);
+
+    return EX_execute_dirty(env, argc, argv);
+}
+
 /**
  * Wraps cairo_fill(caior_t *cr)
- * @brief EX_fill
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_fill_dirty
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_fill(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+static ERL_NIF_TERM EX_fill_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
 
+    damage_note_fill(context->data);
     cairo_fill(context->data);
 
     return ERL_OK;
 }
 
+/**
+ * Wraps cairo_fill(caior_t *cr)
+ * -> Moves to a dirty CPU scheduler if the target surface is large
+ * @brief EX_fill
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_fill(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+
+    ERL_SCHEDULE_DIRTY_IF(SURFACE_AREA(cairo_get_group_target(context->data)) > DIRTY_AREA_THRESHOLD,
+                          "fill", ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_fill_dirty);
+
+    return EX_fill_dirty(env, argc, argv);
+}
+
 /**
  * Wraps cairo_fill_extents(caior_t *cr, double *x1, double *y1, double *x2, double *y2)
  * -> Returns a 4-tuple containing the coordinates since cairo_fill_extents may
@@ -482,6 +865,7 @@ static ERL_NIF_TERM EX_fill_extents(ErlNifEnv* env, int argc, const ERL_NIF_TERM
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double x1, y1, x2, y2;
     enif_get_double(env, argv[1], &x1);
@@ -509,7 +893,10 @@ static ERL_NIF_TERM EX_fill_preserve(ErlNifEnv* env, int argc, const ERL_NIF_TER
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
 
+    damage_note_fill(context->data);
     cairo_fill_preserve(context->data);
 
     return ERL_OK;
@@ -529,6 +916,7 @@ static ERL_NIF_TERM EX_font_extents(ErlNifEnv* env, int argc, const ERL_NIF_TERM
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_font_extents_t font_extents;
     cairo_font_extents(context->data, &font_extents);
@@ -558,6 +946,7 @@ static ERL_NIF_TERM EX_get_antialias(ErlNifEnv* env, int argc, const ERL_NIF_TER
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_antialias_t antialias = cairo_get_antialias(context->data);
     switch(antialias) {
@@ -593,6 +982,7 @@ static ERL_NIF_TERM EX_get_current_point(ErlNifEnv* env, int argc, const ERL_NIF
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double x, y;
     cairo_get_current_point(context->data, &x, &y);
@@ -614,6 +1004,7 @@ static ERL_NIF_TERM EX_get_dash(ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double dashes, offset;
     cairo_get_current_point(context->data, &dashes, &offset);
@@ -635,6 +1026,7 @@ static ERL_NIF_TERM EX_get_dash_count(ErlNifEnv* env, int argc, const ERL_NIF_TE
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     int dash_count = cairo_get_dash_count(context->data);
     return enif_make_int(env, dash_count);
@@ -653,6 +1045,7 @@ static ERL_NIF_TERM EX_get_fill_rule(ErlNifEnv* env, int argc, const ERL_NIF_TER
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_fill_rule_t rule = cairo_get_fill_rule(context->data);
     switch (rule) {
@@ -677,6 +1070,7 @@ static ERL_NIF_TERM EX_get_font_face(ErlNifEnv* env, int argc, const ERL_NIF_TER
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     ERL_MAKE_INSTANCE(cairo_font_face_t_TYPE, cairo_font_face_t_RT, instance);
     ERL_ASSERT(instance);
@@ -701,6 +1095,7 @@ static ERL_NIF_TERM EX_get_font_matrix(ErlNifEnv* env, int argc, const ERL_NIF_T
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_matrix_t matrix;
     cairo_get_font_matrix(context->data, &matrix);
@@ -721,6 +1116,7 @@ static ERL_NIF_TERM EX_get_font_options(ErlNifEnv* env, int argc, const ERL_NIF_
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     ERL_MAKE_INSTANCE(cairo_font_options_t_TYPE, cairo_font_options_t_RT, instance);
     ERL_ASSERT(instance);
@@ -747,6 +1143,7 @@ static ERL_NIF_TERM EX_get_group_target(ErlNifEnv* env, int argc, const ERL_NIF_
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     ERL_MAKE_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, instance);
     ERL_ASSERT(instance);
@@ -770,6 +1167,7 @@ static ERL_NIF_TERM EX_get_line_cap(ErlNifEnv* env, int argc, const ERL_NIF_TERM
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_line_cap_t cap = cairo_get_line_cap(context->data);
     switch (cap) {
@@ -796,6 +1194,7 @@ static ERL_NIF_TERM EX_get_line_join(ErlNifEnv* env, int argc, const ERL_NIF_TER
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_line_join_t join = cairo_get_line_join(context->data);
     switch (join) {
@@ -822,6 +1221,7 @@ static ERL_NIF_TERM EX_get_line_width(ErlNifEnv* env, int argc, const ERL_NIF_TE
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double width = cairo_get_line_width(context->data);
     return enif_make_double(env, width);
@@ -839,6 +1239,7 @@ static ERL_NIF_TERM EX_get_matrix(ErlNifEnv* env, int argc, const ERL_NIF_TERM a
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_matrix_t matrix;
     cairo_get_matrix(context->data, &matrix);
@@ -858,6 +1259,7 @@ static ERL_NIF_TERM EX_get_miter_limit(ErlNifEnv* env, int argc, const ERL_NIF_T
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double limit = cairo_get_miter_limit(context->data);
     return enif_make_double(env, limit);
@@ -875,6 +1277,7 @@ static ERL_NIF_TERM EX_get_operator(ErlNifEnv* env, int argc, const ERL_NIF_TERM
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_operator_t op = cairo_get_operator(context->data);
     switch(op) {
@@ -953,11 +1356,37 @@ static ERL_NIF_TERM EX_get_reference_count(ErlNifEnv* env, int argc, const ERL_N
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     unsigned int count = cairo_get_reference_count(context->data);
     return enif_make_int(env, count);
 }
 
+/**
+ * Wraps cairo_get_scaled_font(cairo_t *cr)
+ * -> The returned resource holds its own reference on the font
+ * @brief EX_get_scaled_font
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_get_scaled_font(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+
+    ERL_MAKE_INSTANCE(cairo_scaled_font_t_TYPE, cairo_scaled_font_t_RT, instance);
+    ERL_ASSERT(instance);
+
+    instance->data = cairo_scaled_font_reference(cairo_get_scaled_font(context->data));
+
+    // Create a garbage-collectable resource
+    ERL_MAKE_GC_RES(instance, font);
+    return ERL_MAKE_OK_TUPLE(font);
+}
+
 /**
  * Wraps cairo_get_source(cairo_t *cr)
  * @brief EX_get_source
@@ -970,6 +1399,7 @@ static ERL_NIF_TERM EX_get_source(ErlNifEnv* env, int argc, const ERL_NIF_TERM a
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     ERL_MAKE_INSTANCE(cairo_pattern_t_TYPE, cairo_pattern_t_RT, instance);
     ERL_ASSERT(instance);
@@ -992,14 +1422,12 @@ static ERL_NIF_TERM EX_get_target(ErlNifEnv* env, int argc, const ERL_NIF_TERM a
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_ASSERT(context->target);
 
-    ERL_MAKE_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, instance);
-    ERL_ASSERT(instance);
-
-    instance->data = cairo_get_target(context->data);
-
-    // The object is owned by cairo, so don't garbage collect it
-    return enif_make_resource(env, instance);
+    // Hand out the surface the context was created for, so both share
+    // one lock
+    return enif_make_resource(env, context->target);
 }
 
 /**
@@ -1014,6 +1442,7 @@ static ERL_NIF_TERM EX_get_tolerance(ErlNifEnv* env, int argc, const ERL_NIF_TER
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double tolerance = cairo_get_tolerance(context->data);
     return enif_make_double(env, tolerance);
@@ -1035,6 +1464,7 @@ static ERL_NIF_TERM EX_has_current_point(ErlNifEnv* env, int argc, const ERL_NIF
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_bool_t result = cairo_has_current_point(context->data);
     return ERL_BOOL(result);
@@ -1052,6 +1482,7 @@ static ERL_NIF_TERM EX_identity_matrix(ErlNifEnv* env, int argc, const ERL_NIF_T
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_identity_matrix(context->data);
     return ERL_OK;
@@ -1059,13 +1490,14 @@ static ERL_NIF_TERM EX_identity_matrix(ErlNifEnv* env, int argc, const ERL_NIF_T
 
 /**
  * Wraps cairo_image_surface_create_from_png(const char *filename)
- * @brief EX_image_surface_create_from_png
+ * -> Variant that may run on a dirty IO scheduler
+ * @brief EX_image_surface_create_from_png_dirty
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_image_surface_create_from_png(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+static ERL_NIF_TERM EX_image_surface_create_from_png_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(1);
     ERL_GET_UTF8_STRING(0, file_name);
 
@@ -1080,6 +1512,116 @@ static ERL_NIF_TERM EX_image_surface_create_from_png(ErlNifEnv* env, int argc, c
 
 }
 
+/**
+ * Wraps cairo_image_surface_create_from_png(const char *filename)
+ * -> The size of the image is unknown until the file has been read,
+ * so loading always happens on a dirty IO scheduler
+ * @brief EX_image_surface_create_from_png
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_image_surface_create_from_png(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_ASSERT(enif_is_binary(env, argv[0]));
+
+    return enif_schedule_nif(env, "image_surface_create_from_png", ERL_NIF_DIRTY_JOB_IO_BOUND,
+                             EX_image_surface_create_from_png_dirty, argc, argv);
+}
+
+/**
+ * Wraps cairo_image_surface_create_from_png_stream(cairo_read_func_t read_func,
+ *   void *closure)
+ * -> The PNG data is read straight from the binary argument
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_image_surface_create_from_png_binary_dirty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_image_surface_create_from_png_binary_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+
+    ErlNifBinary bin;
+    ERL_ASSERT(enif_inspect_binary(env, argv[0], &bin));
+
+    png_reader_t reader = { bin.data, bin.size, 0 };
+    cairo_surface_t *data = cairo_image_surface_create_from_png_stream(png_reader_read, &reader);
+
+    cairo_status_t status = cairo_surface_status(data);
+    if (status != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(data);
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, status));
+    }
+
+    ERL_MAKE_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, instance);
+    if (!instance) {
+        cairo_surface_destroy(data);
+        return enif_make_badarg(env);
+    }
+
+    instance->data = data;
+
+    // Create a garbage-collectable resource
+    ERL_MAKE_GC_RES(instance, surface);
+    return ERL_MAKE_OK_TUPLE(surface);
+}
+
+/**
+ * Wraps cairo_image_surface_create_from_png_stream(cairo_read_func_t read_func,
+ *   void *closure)
+ * -> Moves to a dirty CPU scheduler if the image is large
+ * @brief EX_image_surface_create_from_png_binary
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_image_surface_create_from_png_binary(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+
+    ErlNifBinary bin;
+    ERL_ASSERT(enif_inspect_binary(env, argv[0], &bin));
+
+    // The cost of decoding follows the image size, not the compressed size
+    long area = png_image_area(bin.data, bin.size);
+    ERL_SCHEDULE_DIRTY_IF(area >= 0 ? area > DIRTY_AREA_THRESHOLD : bin.size > PNG_DIRTY_SIZE_THRESHOLD,
+                          "image_surface_create_from_png_binary",
+                          ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_image_surface_create_from_png_binary_dirty);
+
+    return EX_image_surface_create_from_png_binary_dirty(env, argc, argv);
+}
+
+/**
+ * Wraps cairo_image_surface_get_data(cairo_surface_t *surface)
+ * -> Returns a resource binary aliasing the pixel memory, no copy is
+ * made. The binary keeps the surface alive and reflects any drawing
+ * done after it was created.
+ * @brief EX_image_surface_get_data
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_image_surface_get_data(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
+    ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
+
+    // Pending drawing must reach the pixel memory before it is read
+    cairo_surface_flush(surface->data);
+
+    unsigned char *data = cairo_image_surface_get_data(surface->data);
+    ERL_ASSERT(data);
+
+    size_t size = (size_t) cairo_image_surface_get_stride(surface->data) *
+                  cairo_image_surface_get_height(surface->data);
+    return enif_make_resource_binary(env, surface, data, size);
+}
+
 /**
  * Wraps cairo_image_surface_get_height(cairo_surface_t *surface)
  * @brief EX_image_surface_get_height
@@ -1092,6 +1634,7 @@ static ERL_NIF_TERM EX_image_surface_get_height(ErlNifEnv* env, int argc, const
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
     ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
 
     int height = cairo_image_surface_get_height(surface->data);
     return enif_make_int(env, height);
@@ -1109,6 +1652,7 @@ static ERL_NIF_TERM EX_image_surface_get_width(ErlNifEnv* env, int argc, const E
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
     ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
 
     int width = cairo_image_surface_get_width(surface->data);
     return enif_make_int(env, width);
@@ -1126,26 +1670,142 @@ static ERL_NIF_TERM EX_image_surface_get_stride(ErlNifEnv* env, int argc, const
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
     ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
 
     int stride = cairo_image_surface_get_stride(surface->data);
     return enif_make_int(env, stride);
 }
 
 /**
- * Wraps cairo_in_clip(cairo_t *cr, double x, double y)
- * @brief EX_in_clip
+ * Tests the points of a packed <<x::float-64, y::float-64, ...>>
+ * binary against the current path or clip, starting at point index
+ * argv[2]. argv[3] is the hit_test_t resource collecting the bits.
+ * -> The path stays in the context, so it is set up once for all
+ * points
+ * -> Yields with enif_schedule_nif when the timeslice is used up and
+ * continues with the remaining points. The context stays locked by
+ * the hit test across yields and is released after the last point.
+ * @brief EX_hit_test_points
  * @param env
  * @param argc
  * @param argv
- * @return
+ * @return the bitset binary, one bit per point, most significant bit
+ * first and padded with zeros to whole bytes
  */
-static ERL_NIF_TERM EX_in_clip(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-    ERL_ASSERT_ARGC(3);
+static ERL_NIF_TERM EX_hit_test_points(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(4);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
 
-    double x, y;
-    enif_get_double(env, argv[1], &x);
+    ErlNifBinary bin;
+    ERL_ASSERT(enif_inspect_binary(env, argv[1], &bin));
+
+    unsigned long index;
+    ERL_ASSERT(enif_get_ulong(env, argv[2], &index));
+
+    // The lock was taken by start_hit_test on behalf of the test
+    hit_test_t *test;
+    ERL_ASSERT(enif_get_resource(env, argv[3], hit_test_t_RT, (void **) &test));
+    ERL_ASSERT(test->context == context);
+
+    size_t count = bin.size / PACKED_POINT_SIZE;
+    const unsigned char *point = bin.data + index * PACKED_POINT_SIZE;
+
+    while (index < count) {
+        size_t end = index + ITEMS_PER_CHUNK < count ? index + ITEMS_PER_CHUNK : count;
+        for (; index < end; index++, point += PACKED_POINT_SIZE) {
+            double x = read_double_be(point);
+            double y = read_double_be(point + 8);
+
+            cairo_bool_t hit;
+            switch (test->kind) {
+            case HIT_TEST_FILL:
+                hit = cairo_in_fill(context->data, x, y);
+                break;
+            case HIT_TEST_STROKE:
+                hit = cairo_in_stroke(context->data, x, y);
+                break;
+            default:
+                hit = cairo_in_clip(context->data, x, y);
+                break;
+            }
+
+            if (hit) {
+                test->bits[index >> 3] |= 0x80 >> (index & 7);
+            }
+        }
+
+        if (index < count && enif_consume_timeslice(env, TIMESLICE_PERCENT)) {
+            ERL_NIF_TERM next_argv[4] = { argv[0], argv[1], enif_make_ulong(env, index), argv[3] };
+            return enif_schedule_nif(env, "hit_test_points", 0, EX_hit_test_points, 4, next_argv);
+        }
+    }
+
+    hit_test_release_context(test);
+
+    ERL_NIF_TERM result;
+    unsigned char *out = enif_make_new_binary(env, test->size, &result);
+    memcpy(out, test->bits, test->size);
+    return result;
+}
+
+/**
+ * Starts a batch hit test of kind over the points in argv[1]
+ * @brief start_hit_test
+ * @return the bitset binary, see EX_hit_test_points
+ */
+static ERL_NIF_TERM start_hit_test(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[], hit_test_kind_t kind) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+
+    ErlNifBinary bin;
+    ERL_ASSERT(enif_inspect_binary(env, argv[1], &bin));
+    ERL_ASSERT(bin.size % PACKED_POINT_SIZE == 0);
+
+    hit_test_t *test = enif_alloc_resource(hit_test_t_RT, sizeof(hit_test_t));
+    ERL_ASSERT(test);
+
+    test->kind = kind;
+    test->context = NULL;
+    test->size = (bin.size / PACKED_POINT_SIZE + 7) / 8;
+    test->bits = enif_alloc(test->size ? test->size : 1);
+    if (!test->bits) {
+        enif_release_resource(test);
+        return enif_make_badarg(env);
+    }
+    memset(test->bits, 0, test->size);
+
+    // The test owns the context lock across yields, like a render job
+    if (!resource_trylock(&context->lock, (unsigned long) test)) {
+        enif_release_resource(test);
+        return ERL_BUSY;
+    }
+    test->context = context;
+    enif_keep_resource(context);
+
+    ERL_MAKE_GC_RES(test, state);
+
+    ERL_NIF_TERM test_argv[4] = { argv[0], argv[1], enif_make_ulong(env, 0), state };
+    return EX_hit_test_points(env, 4, test_argv);
+}
+
+/**
+ * Wraps cairo_in_clip(cairo_t *cr, double x, double y)
+ * @brief EX_in_clip
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_in_clip(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(3);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+
+    double x, y;
+    enif_get_double(env, argv[1], &x);
     enif_get_double(env, argv[2], &y);
 
     cairo_bool_t result = cairo_in_clip(context->data, x, y);
@@ -1164,6 +1824,7 @@ static ERL_NIF_TERM EX_in_fill(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv
     ERL_ASSERT_ARGC(3);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double x, y;
     enif_get_double(env, argv[1], &x);
@@ -1185,15 +1846,55 @@ static ERL_NIF_TERM EX_in_stroke(ErlNifEnv* env, int argc, const ERL_NIF_TERM ar
     ERL_ASSERT_ARGC(3);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double x, y;
     enif_get_double(env, argv[1], &x);
     enif_get_double(env, argv[2], &y);
 
-    cairo_bool_t result = cairo_in_fill(context->data, x, y);
+    cairo_bool_t result = cairo_in_stroke(context->data, x, y);
     return ERL_BOOL(result);
 }
 
+/**
+ * Batch variant of cairo_in_clip over a packed
+ * <<x::float-64, y::float-64, ...>> binary
+ * @brief EX_in_clip_many
+ * @param env
+ * @param argc
+ * @param argv
+ * @return a bitset binary, see EX_hit_test_points
+ */
+static ERL_NIF_TERM EX_in_clip_many(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    return start_hit_test(env, argc, argv, HIT_TEST_CLIP);
+}
+
+/**
+ * Batch variant of cairo_in_fill over a packed
+ * <<x::float-64, y::float-64, ...>> binary
+ * @brief EX_in_fill_many
+ * @param env
+ * @param argc
+ * @param argv
+ * @return a bitset binary, see EX_hit_test_points
+ */
+static ERL_NIF_TERM EX_in_fill_many(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    return start_hit_test(env, argc, argv, HIT_TEST_FILL);
+}
+
+/**
+ * Batch variant of cairo_in_stroke over a packed
+ * <<x::float-64, y::float-64, ...>> binary
+ * @brief EX_in_stroke_many
+ * @param env
+ * @param argc
+ * @param argv
+ * @return a bitset binary, see EX_hit_test_points
+ */
+static ERL_NIF_TERM EX_in_stroke_many(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    return start_hit_test(env, argc, argv, HIT_TEST_STROKE);
+}
+
 /**
  * Wraps cairo_mask(cairo_t *cr, cairo_pattern_t *pattern)
  * @brief EX_mask
@@ -1206,10 +1907,13 @@ static ERL_NIF_TERM EX_mask(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
     ERL_ASSERT_ARGC(2);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
 
     ERL_GET_INSTANCE(cairo_pattern_t_TYPE, cairo_pattern_t_RT, 1, pattern);
     ERL_ASSERT(pattern);
 
+    damage_note_paint(context->data);
     cairo_mask(context->data, pattern->data);
 
     return ERL_OK;
@@ -1217,31 +1921,58 @@ static ERL_NIF_TERM EX_mask(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[])
 
 /**
  * Wraps cairo_mask_surface(cairo_t *cr, cairo_surface_t *surface)
- * @brief EX_mask_surface
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_mask_surface_dirty
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_mask_surface(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+static ERL_NIF_TERM EX_mask_surface_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(4);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
 
     ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 1, surface);
     ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
 
     double surface_x, surface_y;
     enif_get_double(env, argv[2], &surface_x);
     enif_get_double(env, argv[3], &surface_y);
 
+    damage_note_paint(context->data);
     cairo_mask_surface(context->data, surface->data, surface_x, surface_y);
 
     return ERL_OK;
 }
 
+/**
+ * Wraps cairo_mask_surface(cairo_t *cr, cairo_surface_t *surface)
+ * -> Moves to a dirty CPU scheduler if the target surface is large
+ * @brief EX_mask_surface
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_mask_surface(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(4);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+
+    ERL_SCHEDULE_DIRTY_IF(SURFACE_AREA(cairo_get_group_target(context->data)) > DIRTY_AREA_THRESHOLD,
+                          "mask_surface", ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_mask_surface_dirty);
+
+    return EX_mask_surface_dirty(env, argc, argv);
+}
+
 /**
  * Wraps cairo_matrix_init(cairo_matrix_t *matrix, double xx, double yx, double xy, double x0, doubel y0)
+ * -> Returns {:ok, matrix} with a mutable matrix resource
  * @brief EX_matrix_init
  * @param env
  * @param argc
@@ -1252,21 +1983,22 @@ static ERL_NIF_TERM EX_matrix_init(ErlNifEnv* env, int argc, const ERL_NIF_TERM
     ERL_ASSERT_ARGC(6);
 
     double xx, yx, xy, yy, x0, y0;
-    enif_get_double(env, argv[0], &xx);
-    enif_get_double(env, argv[1], &yx);
-    enif_get_double(env, argv[2], &xy);
-    enif_get_double(env, argv[3], &yy);
-    enif_get_double(env, argv[4], &x0);
-    enif_get_double(env, argv[5], &y0);
+    ERL_ASSERT(get_number(env, argv[0], &xx));
+    ERL_ASSERT(get_number(env, argv[1], &yx));
+    ERL_ASSERT(get_number(env, argv[2], &xy));
+    ERL_ASSERT(get_number(env, argv[3], &yy));
+    ERL_ASSERT(get_number(env, argv[4], &x0));
+    ERL_ASSERT(get_number(env, argv[5], &y0));
 
     cairo_matrix_t matrix;
     cairo_matrix_init(&matrix, xx, yx, xy, yy, x0, y0);
 
-    return ERL_EXPORT_MATRIX(matrix);
+    return make_matrix(env, &matrix);
 }
 
 /**
  * Wraps cairo_matrix_init_identity(cairo_matrix_t *matrix)
+ * -> Returns {:ok, matrix} with a mutable matrix resource
  * @brief EX_matrix_init_identity
  * @param env
  * @param argc
@@ -1277,11 +2009,12 @@ static ERL_NIF_TERM EX_matrix_init_identity(ErlNifEnv* env, int argc, const ERL_
     ERL_ASSERT_ARGC(0);
     cairo_matrix_t matrix;
     cairo_matrix_init_identity(&matrix);
-    return ERL_EXPORT_MATRIX(matrix);
+    return make_matrix(env, &matrix);
 }
 
 /**
  * Wraps cairo_matrix_init_rotate(cairo_matrix_t *matrix, double radians)
+ * -> Returns {:ok, matrix} with a mutable matrix resource
  * @brief EX_matrix_init_rotate
  * @param env
  * @param argc
@@ -1292,16 +2025,17 @@ static ERL_NIF_TERM EX_matrix_init_rotate(ErlNifEnv* env, int argc, const ERL_NI
     ERL_ASSERT_ARGC(1);
 
     double radians;
-    enif_get_double(env, argv[0], &radians);
+    ERL_ASSERT(get_number(env, argv[0], &radians));
 
     cairo_matrix_t matrix;
     cairo_matrix_init_rotate(&matrix, radians);
 
-    return ERL_EXPORT_MATRIX(matrix);
+    return make_matrix(env, &matrix);
 }
 
 /**
  * Wraps cairo_matrix_init_scale(cairo_matrix_t *matrix, double sx, double sy)
+ * -> Returns {:ok, matrix} with a mutable matrix resource
  * @brief EX_matrix_init_scale
  * @param env
  * @param argc
@@ -1312,17 +2046,18 @@ static ERL_NIF_TERM EX_matrix_init_scale(ErlNifEnv* env, int argc, const ERL_NIF
     ERL_ASSERT_ARGC(2);
 
     double sx, sy;
-    enif_get_double(env, argv[0], &sx);
-    enif_get_double(env, argv[1], &sy);
+    ERL_ASSERT(get_number(env, argv[0], &sx));
+    ERL_ASSERT(get_number(env, argv[1], &sy));
 
     cairo_matrix_t matrix;
     cairo_matrix_init_scale(&matrix, sx, sy);
 
-    return ERL_EXPORT_MATRIX(matrix);
+    return make_matrix(env, &matrix);
 }
 
 /**
  * Wraps cairo_matrix_init_translate(cairo_matrix_t *matrix, double tx, double ty)
+ * -> Returns {:ok, matrix} with a mutable matrix resource
  * @brief EX_matrix_init_translate
  * @param env
  * @param argc
@@ -1333,17 +2068,20 @@ static ERL_NIF_TERM EX_matrix_init_translate(ErlNifEnv* env, int argc, const ERL
     ERL_ASSERT_ARGC(2);
 
     double tx, ty;
-    enif_get_double(env, argv[0], &tx);
-    enif_get_double(env, argv[1], &ty);
+    ERL_ASSERT(get_number(env, argv[0], &tx));
+    ERL_ASSERT(get_number(env, argv[1], &ty));
 
     cairo_matrix_t matrix;
     cairo_matrix_init_translate(&matrix, tx, ty);
 
-    return ERL_EXPORT_MATRIX(matrix);
+    return make_matrix(env, &matrix);
 }
 
 /**
  * Wraps cairo_matrix_invert(cairo_matrix_t *matrix)
+ * -> Inverts the matrix resource in place. Returns :ok, or
+ * {:error, :invalid_matrix} and leaves the matrix unchanged if it
+ * has no inverse.
  * @brief EX_matrix_invert
  * @param env
  * @param argc
@@ -1352,14 +2090,16 @@ static ERL_NIF_TERM EX_matrix_init_translate(ErlNifEnv* env, int argc, const ERL
  */
 static ERL_NIF_TERM EX_matrix_invert(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(1);
-    ERL_IMPORT_MATRIX(0, matrix);
+    ERL_GET_INSTANCE(cairo_matrix_t_TYPE, cairo_matrix_t_RT, 0, matrix);
+    ERL_ASSERT(matrix);
+    ERL_LOCK_INSTANCE(matrix);
 
-    cairo_status_t status = cairo_matrix_invert(&matrix);
-    if (status == CAIRO_STATUS_INVALID_MATRIX) {
-        return enif_make_badarg(env);
-    } else {
-        return ERL_EXPORT_MATRIX(matrix);
+    // cairo leaves the matrix untouched when it is not invertible
+    if (cairo_matrix_invert(&matrix->data) != CAIRO_STATUS_SUCCESS) {
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_atom(env, "invalid_matrix"));
     }
+
+    return ERL_OK;
 }
 
 /**
@@ -1368,6 +2108,9 @@ static ERL_NIF_TERM EX_matrix_invert(ErlNifEnv* env, int argc, const ERL_NIF_TER
  *  const cairo_matrix_t *a,
  *  const cairo_matrix_t *b
  * )
+ * -> Multiplies the matrix resource by the second matrix in place, so
+ * that it first applies its previous transformation and then the
+ * second one
  * @brief EX_matrix_multiply
  * @param env
  * @param argc
@@ -1376,12 +2119,14 @@ static ERL_NIF_TERM EX_matrix_invert(ErlNifEnv* env, int argc, const ERL_NIF_TER
  */
 static ERL_NIF_TERM EX_matrix_multiply(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(2);
-    ERL_IMPORT_MATRIX(0, matrix_a);
-    ERL_IMPORT_MATRIX(1, matrix_b);
+    ERL_GET_INSTANCE(cairo_matrix_t_TYPE, cairo_matrix_t_RT, 0, matrix);
+    ERL_ASSERT(matrix);
+    ERL_IMPORT_MATRIX(1, other);
+    ERL_LOCK_INSTANCE(matrix);
 
-    cairo_matrix_t result;
-    cairo_matrix_multiply(&result, &matrix_a, &matrix_b);
-    return ERL_EXPORT_MATRIX(result);
+    // cairo_matrix_multiply allows the result to alias an operand
+    cairo_matrix_multiply(&matrix->data, &matrix->data, &other);
+    return ERL_OK;
 }
 
 /**
@@ -1389,6 +2134,7 @@ static ERL_NIF_TERM EX_matrix_multiply(ErlNifEnv* env, int argc, const ERL_NIF_T
  *  cairo_matrix_t *matrix,
  *  double radians
  * )
+ * -> Rotates the matrix resource in place
  * @brief EX_matrix_rotate
  * @param env
  * @param argc
@@ -1397,13 +2143,15 @@ static ERL_NIF_TERM EX_matrix_multiply(ErlNifEnv* env, int argc, const ERL_NIF_T
  */
 static ERL_NIF_TERM EX_matrix_rotate(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(2);
-    ERL_IMPORT_MATRIX(0, matrix);
+    ERL_GET_INSTANCE(cairo_matrix_t_TYPE, cairo_matrix_t_RT, 0, matrix);
+    ERL_ASSERT(matrix);
 
     double radians;
-    enif_get_double(env, argv[1], &radians);
+    ERL_ASSERT(get_number(env, argv[1], &radians));
 
-    cairo_matrix_rotate(&matrix, radians);
-    return ERL_EXPORT_MATRIX(matrix);
+    ERL_LOCK_INSTANCE(matrix);
+    cairo_matrix_rotate(&matrix->data, radians);
+    return ERL_OK;
 }
 
 /**
@@ -1412,6 +2160,7 @@ static ERL_NIF_TERM EX_matrix_rotate(ErlNifEnv* env, int argc, const ERL_NIF_TER
  *  double sx,
  *  double sy
  * )
+ * -> Scales the matrix resource in place
  * @brief EX_matrix_scale
  * @param env
  * @param argc
@@ -1420,13 +2169,30 @@ static ERL_NIF_TERM EX_matrix_rotate(ErlNifEnv* env, int argc, const ERL_NIF_TER
  */
 static ERL_NIF_TERM EX_matrix_scale(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(3);
-    ERL_IMPORT_MATRIX(0, matrix);
+    ERL_GET_INSTANCE(cairo_matrix_t_TYPE, cairo_matrix_t_RT, 0, matrix);
+    ERL_ASSERT(matrix);
 
     double sx, sy;
-    enif_get_double(env, argv[1], &sx);
-    enif_get_double(env, argv[2], &sy);
+    ERL_ASSERT(get_number(env, argv[1], &sx));
+    ERL_ASSERT(get_number(env, argv[2], &sy));
+
+    ERL_LOCK_INSTANCE(matrix);
+    cairo_matrix_scale(&matrix->data, sx, sy);
+    return ERL_OK;
+}
 
-    cairo_matrix_scale(&matrix, sx, sy);
+/**
+ * Exports a matrix resource in the
+ * {{xx, yx}, {xy, yy}, {x0, y0}} tuple format
+ * @brief EX_matrix_to_tuple
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_matrix_to_tuple(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_IMPORT_MATRIX(0, matrix);
     return ERL_EXPORT_MATRIX(matrix);
 }
 
@@ -1447,8 +2213,8 @@ static ERL_NIF_TERM EX_matrix_transform_distance(ErlNifEnv* env, int argc, const
     ERL_IMPORT_MATRIX(0, matrix);
 
     double dx, dy;
-    enif_get_double(env, argv[1], &dx);
-    enif_get_double(env, argv[2], &dy);
+    ERL_ASSERT(get_number(env, argv[1], &dx));
+    ERL_ASSERT(get_number(env, argv[2], &dy));
 
     cairo_matrix_transform_distance(&matrix, &dx, &dy);
     return enif_make_tuple2(env, enif_make_double(env, dx), enif_make_double(env, dy));
@@ -1471,19 +2237,93 @@ static ERL_NIF_TERM EX_matrix_transform_point(ErlNifEnv* env, int argc, const ER
     ERL_IMPORT_MATRIX(0, matrix);
 
     double x, y;
-    enif_get_double(env, argv[1], &x);
-    enif_get_double(env, argv[2], &y);
+    ERL_ASSERT(get_number(env, argv[1], &x));
+    ERL_ASSERT(get_number(env, argv[2], &y));
 
     cairo_matrix_transform_point(&matrix, &x, &y);
     return enif_make_tuple2(env, enif_make_double(env, x), enif_make_double(env, y));
 }
 
+/**
+ * Transforms a packed binary of <<x::float-64, y::float-64>> points
+ * -> Points are converted to native doubles one block at a time, so
+ * the transform itself is a plain loop over arrays the compiler can
+ * vectorize
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_matrix_transform_points_dirty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_matrix_transform_points_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+    ERL_IMPORT_MATRIX(0, matrix);
+
+    ErlNifBinary points;
+    ERL_ASSERT(enif_inspect_binary(env, argv[1], &points));
+    ERL_ASSERT(points.size % PACKED_POINT_SIZE == 0);
+
+    ERL_NIF_TERM result;
+    unsigned char *out = enif_make_new_binary(env, points.size, &result);
+
+    double xs[POINT_BLOCK], ys[POINT_BLOCK];
+    size_t count = points.size / PACKED_POINT_SIZE;
+    size_t start;
+    for (start = 0; start < count; start += POINT_BLOCK) {
+        size_t block = count - start < POINT_BLOCK ? count - start : POINT_BLOCK;
+        const unsigned char *in = points.data + start * PACKED_POINT_SIZE;
+        size_t i;
+
+        for (i = 0; i < block; i++) {
+            xs[i] = read_double_be(in + i * PACKED_POINT_SIZE);
+            ys[i] = read_double_be(in + i * PACKED_POINT_SIZE + 8);
+        }
+
+        for (i = 0; i < block; i++) {
+            double x = xs[i], y = ys[i];
+            xs[i] = matrix.xx * x + matrix.xy * y + matrix.x0;
+            ys[i] = matrix.yx * x + matrix.yy * y + matrix.y0;
+        }
+
+        for (i = 0; i < block; i++) {
+            write_double_be(out, xs[i]);
+            write_double_be(out + 8, ys[i]);
+            out += PACKED_POINT_SIZE;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Transforms a packed binary of points, see EX_matrix_transform_points_dirty
+ * -> Moves to a dirty CPU scheduler for large inputs
+ * @brief EX_matrix_transform_points
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_matrix_transform_points(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+
+    ErlNifBinary points;
+    ERL_ASSERT(enif_inspect_binary(env, argv[1], &points));
+
+    ERL_SCHEDULE_DIRTY_IF(points.size / PACKED_POINT_SIZE > 16 * ITEMS_PER_CHUNK, "matrix_transform_points",
+                          ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_matrix_transform_points_dirty);
+
+    return EX_matrix_transform_points_dirty(env, argc, argv);
+}
+
 /**
  * Wraps cairo_matrix_translate(
  *  cairo_matrix_t *matrix,
  *  double tx,
  *  double ty
  * )
+ * -> Translates the matrix resource in place
  * @brief EX_matrix_translate
  * @param env
  * @param argc
@@ -1492,14 +2332,16 @@ static ERL_NIF_TERM EX_matrix_transform_point(ErlNifEnv* env, int argc, const ER
  */
 static ERL_NIF_TERM EX_matrix_translate(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(3);
-    ERL_IMPORT_MATRIX(0, matrix);
+    ERL_GET_INSTANCE(cairo_matrix_t_TYPE, cairo_matrix_t_RT, 0, matrix);
+    ERL_ASSERT(matrix);
 
     double tx, ty;
-    enif_get_double(env, argv[1], &tx);
-    enif_get_double(env, argv[2], &ty);
+    ERL_ASSERT(get_number(env, argv[1], &tx));
+    ERL_ASSERT(get_number(env, argv[2], &ty));
 
-    cairo_matrix_translate(&matrix, tx, ty);
-    return ERL_EXPORT_MATRIX(matrix);
+    ERL_LOCK_INSTANCE(matrix);
+    cairo_matrix_translate(&matrix->data, tx, ty);
+    return ERL_OK;
 }
 
 // TODO
@@ -1519,6 +2361,7 @@ static ERL_NIF_TERM EX_new_path(ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_new_path(context->data);
 
@@ -1537,6 +2380,7 @@ static ERL_NIF_TERM EX_new_sub_path(ErlNifEnv* env, int argc, const ERL_NIF_TERM
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_new_sub_path(context->data);
 
@@ -1545,22 +2389,47 @@ static ERL_NIF_TERM EX_new_sub_path(ErlNifEnv* env, int argc, const ERL_NIF_TERM
 
 /**
  * Wraps cairo_paint()
- * @brief EX_paint
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_paint_dirty
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_paint(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+static ERL_NIF_TERM EX_paint_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
 
+    damage_note_paint(context->data);
     cairo_paint(context->data);
 
     return ERL_OK;
 }
 
+/**
+ * Wraps cairo_paint()
+ * -> Moves to a dirty CPU scheduler if the target surface is large
+ * @brief EX_paint
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_paint(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+
+    ERL_SCHEDULE_DIRTY_IF(SURFACE_AREA(cairo_get_group_target(context->data)) > DIRTY_AREA_THRESHOLD,
+                          "paint", ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_paint_dirty);
+
+    return EX_paint_dirty(env, argc, argv);
+}
+
 /**
  * Wraps cairo_paint_with_alpha()
  * @brief EX_paint_with_alpha
@@ -1573,10 +2442,13 @@ static ERL_NIF_TERM EX_paint_with_alpha(ErlNifEnv* env, int argc, const ERL_NIF_
     ERL_ASSERT_ARGC(2);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
 
     double alpha;
     enif_get_double(env, argv[1], &alpha);
 
+    damage_note_paint(context->data);
     cairo_paint_with_alpha(context->data, alpha);
 
     return ERL_OK;
@@ -1594,6 +2466,7 @@ static ERL_NIF_TERM EX_path_extents(ErlNifEnv* env, int argc, const ERL_NIF_TERM
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double x1, y1, x2, y2;
     cairo_path_extents(context->data, &x1, &y1, &x2, &y2);
@@ -1605,6 +2478,26 @@ static ERL_NIF_TERM EX_path_extents(ErlNifEnv* env, int argc, const ERL_NIF_TERM
                             enif_make_double(env, y2));
 }
 
+/**
+ * Encodes a path resource as a packed binary of
+ * <<op::8, points::float-64...>> elements, where op is 0 (move_to,
+ * 1 point), 1 (line_to, 1 point), 2 (curve_to, 3 points) or
+ * 3 (close_path, no points)
+ * @brief EX_path_to_binary
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_path_to_binary(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_path_t_TYPE, cairo_path_t_RT, 0, path);
+    ERL_ASSERT(path && path->data);
+    ERL_ASSERT(path->data->status == CAIRO_STATUS_SUCCESS);
+
+    return make_packed_path(env, path->data);
+}
+
 /**
  * Wraps cairo_pattern_add_color_stop_rgb(cairo_pattern_t* pattern,
  *  double offset,
@@ -1675,6 +2568,7 @@ static ERL_NIF_TERM EX_pattern_create_for_surface(ErlNifEnv* env, int argc, cons
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface)
     ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
 
     ERL_MAKE_INSTANCE(cairo_pattern_t_TYPE, cairo_pattern_t_RT, instance);
     ERL_ASSERT(instance);
@@ -2040,6 +2934,128 @@ static ERL_NIF_TERM EX_pattern_status(ErlNifEnv* env, int argc, const ERL_NIF_TE
 // cairo_pdf_*
 // cairo_ps_*
 
+/**
+ * Adds the points of a packed <<x::float-64, y::float-64, ...>> binary
+ * to the current path, starting at point index argv[2]. The first point
+ * of the binary starts a new sub-path. argv[3] is the points_path_t
+ * resource of the call; if its close flag is set the sub-path is closed
+ * after the last point.
+ * -> Yields with enif_schedule_nif when the timeslice is used up and
+ * continues with the remaining points. The context stays locked by
+ * the job across yields and is released after the last point.
+ * @brief EX_points_to_path
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_points_to_path(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(4);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+
+    ErlNifBinary bin;
+    ERL_ASSERT(enif_inspect_binary(env, argv[1], &bin));
+
+    unsigned long index;
+    ERL_ASSERT(enif_get_ulong(env, argv[2], &index));
+
+    // The lock was taken by start_points_to_path on behalf of the job
+    points_path_t *job;
+    ERL_ASSERT(enif_get_resource(env, argv[3], points_path_t_RT, (void **) &job));
+    ERL_ASSERT(job->context == context);
+
+    size_t count = bin.size / PACKED_POINT_SIZE;
+    ERL_ASSERT(index <= count);
+
+    const unsigned char *point = bin.data + index * PACKED_POINT_SIZE;
+
+    if (index == 0 && count > 0) {
+        cairo_move_to(context->data, read_double_be(point), read_double_be(point + 8));
+        point += PACKED_POINT_SIZE;
+        index++;
+    }
+
+    while (index < count) {
+        size_t end = index + ITEMS_PER_CHUNK < count ? index + ITEMS_PER_CHUNK : count;
+        for (; index < end; index++, point += PACKED_POINT_SIZE) {
+            cairo_line_to(context->data, read_double_be(point), read_double_be(point + 8));
+        }
+
+        if (index < count && enif_consume_timeslice(env, TIMESLICE_PERCENT)) {
+            ERL_NIF_TERM next_argv[4] = { argv[0], argv[1], enif_make_ulong(env, index), argv[3] };
+            return enif_schedule_nif(env, "points_to_path", 0, EX_points_to_path, 4, next_argv);
+        }
+    }
+
+    if (count > 0 && job->close) {
+        cairo_close_path(context->data);
+    }
+
+    points_path_release_context(job);
+    return ERL_OK;
+}
+
+/**
+ * Starts adding the points in argv[1] to the path of the context
+ * @brief start_points_to_path
+ * @return see EX_points_to_path
+ */
+static ERL_NIF_TERM start_points_to_path(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[], int close) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+
+    ErlNifBinary bin;
+    ERL_ASSERT(enif_inspect_binary(env, argv[1], &bin));
+    ERL_ASSERT(bin.size % PACKED_POINT_SIZE == 0);
+
+    points_path_t *job = enif_alloc_resource(points_path_t_RT, sizeof(points_path_t));
+    ERL_ASSERT(job);
+
+    job->close = close;
+    job->context = NULL;
+
+    // The job owns the context lock across yields, like a hit test
+    if (!resource_trylock(&context->lock, (unsigned long) job)) {
+        enif_release_resource(job);
+        return ERL_BUSY;
+    }
+    job->context = context;
+    enif_keep_resource(context);
+
+    ERL_MAKE_GC_RES(job, state);
+
+    ERL_NIF_TERM points_argv[4] = { argv[0], argv[1], enif_make_ulong(env, 0), state };
+    return EX_points_to_path(env, 4, points_argv);
+}
+
+/**
+ * Starts a new sub-path at the first point of a packed
+ * <<x::float-64, y::float-64, ...>> binary and adds lines to all
+ * following points
+ * @brief EX_polyline
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_polyline(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    return start_points_to_path(env, argc, argv, 0);
+}
+
+/**
+ * Like EX_polyline but closes the sub-path after the last point
+ * @brief EX_polygon
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_polygon(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    return start_points_to_path(env, argc, argv, 1);
+}
+
 /**
  * Wraps cairo_push_group(cairo_t *cr);
  * @brief EX_push_group
@@ -2052,6 +3068,7 @@ static ERL_NIF_TERM EX_push_group(ErlNifEnv* env, int argc, const ERL_NIF_TERM a
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context)
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_push_group(context->data);
 
@@ -2075,6 +3092,7 @@ static ERL_NIF_TERM EX_pop_group(ErlNifEnv* env, int argc, const ERL_NIF_TERM ar
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context)
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_pop_group(context->data);
 
@@ -2093,6 +3111,7 @@ static ERL_NIF_TERM EX_pop_group_to_source(ErlNifEnv* env, int argc, const ERL_N
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context)
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_pop_group_to_source(context->data);
 
@@ -2112,6 +3131,7 @@ static ERL_NIF_TERM EX_push_group_with_content(ErlNifEnv* env, int argc, const E
     ERL_ASSERT_ARGC(2);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context)
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     cairo_content_t content;
     ERL_TRY_ATOM(1,     ET_color,       content, CAIRO_CONTENT_COLOR)
@@ -2125,263 +3145,2607 @@ static ERL_NIF_TERM EX_push_group_with_content(ErlNifEnv* env, int argc, const E
 }
 
 /**
- * Wraps cairo_recording_surface_create(
- *  cairo_content_t content,
- *  const cairo_rectangle_t *extents);
- * @brief EX_recording_surface_create
+ * Drops all entries of the raster cache
+ * @brief EX_raster_cache_clear
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_recording_surface_create(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-    ERL_ASSERT_ARGC(2);
+static ERL_NIF_TERM EX_raster_cache_clear(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(0);
 
-    cairo_content_t content;
-    ERL_TRY_ATOM(0,     ET_color,       content, CAIRO_CONTENT_COLOR)
-    _ERL_TRY_ATOM(0,    ET_alpha,       content, CAIRO_CONTENT_ALPHA)
-    _ERL_TRY_ATOM(0,    ET_color_alpha, content, CAIRO_CONTENT_COLOR_ALPHA)
-    _ERL_FAIL_ATOM;
+    raster_cache_clear();
+    return ERL_OK;
+}
 
-    int arity = 4;
-    const ERL_NIF_TERM *tuple;
-    ERL_ASSERT(enif_get_tuple(env, argv[1], &arity, &tuple));
+/**
+ * Sets the maximum number of pixel bytes held by the raster cache.
+ * 0 disables the cache.
+ * @brief EX_raster_cache_configure
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_raster_cache_configure(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
 
-    cairo_rectangle_t rect;
-    enif_get_double(env, tuple[0], &rect.x);
-    enif_get_double(env, tuple[1], &rect.y);
-    enif_get_double(env, tuple[2], &rect.width);
+    ErlNifUInt64 max_bytes;
+    ERL_ASSERT(enif_get_uint64(env, argv[0], &max_bytes));
+
+    raster_cache_configure((size_t) max_bytes);
+    return ERL_OK;
+}
+
+/**
+ * Rasterizes a recording surface under a transform into a new image
+ * surface of the given format and size, going through the raster
+ * cache. A hit copies the cached pixels instead of replaying the
+ * recording; the cached image itself is never handed out, so drawing
+ * on the result can't corrupt the cache.
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_raster_cache_render_dirty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_raster_cache_render_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(5);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, recording);
+    ERL_ASSERT(recording);
+    ERL_ASSERT(cairo_surface_get_type(recording->data) == CAIRO_SURFACE_TYPE_RECORDING);
+    ERL_LOCK_INSTANCE(recording);
+
+    ERL_IMPORT_MATRIX(1, matrix);
+
+    cairo_format_t format = -1;
+    ERL_TRY_ATOM(2, ET_argb32,      format, 0)
+    _ERL_TRY_ATOM(2, ET_rgb24,       format, 1)
+    _ERL_TRY_ATOM(2, ET_a8,          format, 2)
+    _ERL_TRY_ATOM(2, ET_a1,          format, 3)
+    _ERL_TRY_ATOM(2, ET_rgb16_565,   format, 4)
+    _ERL_TRY_ATOM(2, ET_rgb30,       format, 5)
+    _ERL_FAIL_ATOM;
+
+    ERL_GET_INT(3, width);
+    ERL_GET_INT(4, height);
+    ERL_ASSERT(width > 0 && height > 0);
+
+    // The unlocked read of the limit only decides whether to bother
+    unsigned long serial = raster_cache.max_bytes > 0 ? recording_serial(recording->data) : 0;
+    cairo_surface_t *cached = serial ? raster_cache_lookup(serial, &matrix, format, width, height) : NULL;
+
+    cairo_surface_t *data = surface_pool_checkout(format, width, height, cached == NULL);
+    if (!data) {
+        data = cairo_image_surface_create(format, width, height);
+    }
+    if (cairo_surface_status(data) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(data);
+        if (cached) cairo_surface_destroy(cached);
+        return enif_make_badarg(env);
+    }
+
+    if (cached) {
+        cairo_surface_flush(data);
+        memcpy(cairo_image_surface_get_data(data), cairo_image_surface_get_data(cached),
+               (size_t) cairo_image_surface_get_stride(cached) * height);
+        cairo_surface_mark_dirty(data);
+        cairo_surface_destroy(cached);
+    } else {
+        cairo_t *cr = cairo_create(data);
+        cairo_transform(cr, &matrix);
+        cairo_set_source_surface(cr, recording->data, 0, 0);
+        cairo_paint(cr);
+        cairo_status_t status = cairo_status(cr);
+        cairo_destroy(cr);
+
+        if (status != CAIRO_STATUS_SUCCESS) {
+            cairo_surface_destroy(data);
+            return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, status));
+        }
+
+        if (serial) {
+            // The cache keeps its own copy, the result may be drawn on
+            cairo_surface_t *copy = cairo_image_surface_create(format, width, height);
+            if (cairo_surface_status(copy) == CAIRO_STATUS_SUCCESS) {
+                cairo_surface_flush(data);
+                cairo_surface_flush(copy);
+                memcpy(cairo_image_surface_get_data(copy), cairo_image_surface_get_data(data),
+                       (size_t) cairo_image_surface_get_stride(data) * height);
+                cairo_surface_mark_dirty(copy);
+                raster_cache_insert(serial, &matrix, format, width, height, copy);
+            }
+            cairo_surface_destroy(copy);
+        }
+    }
+
+    ERL_MAKE_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, instance);
+    if (!instance) {
+        cairo_surface_destroy(data);
+        return enif_make_badarg(env);
+    }
+
+    instance->data = data;
+
+    // Create a garbage-collectable resource
+    ERL_MAKE_GC_RES(instance, surface);
+    return ERL_MAKE_OK_TUPLE(surface);
+}
+
+/**
+ * Rasterizes a recording surface through the raster cache
+ * -> Moves to a dirty CPU scheduler if the image is large
+ * @brief EX_raster_cache_render
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_raster_cache_render(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(5);
+    ERL_GET_INT(3, width);
+    ERL_GET_INT(4, height);
+
+    ERL_SCHEDULE_DIRTY_IF((long) width * height > DIRTY_AREA_THRESHOLD, "raster_cache_render",
+                          ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_raster_cache_render_dirty);
+
+    return EX_raster_cache_render_dirty(env, argc, argv);
+}
+
+/**
+ * Reports the raster cache as
+ * {entries, bytes, max_bytes, hits, misses}
+ * @brief EX_raster_cache_stats
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_raster_cache_stats(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(0);
+
+    enif_mutex_lock(raster_cache.lock);
+    ERL_NIF_TERM stats = enif_make_tuple5(env,
+                                          enif_make_ulong(env, raster_cache.entries),
+                                          enif_make_uint64(env, raster_cache.bytes),
+                                          enif_make_uint64(env, raster_cache.max_bytes),
+                                          enif_make_ulong(env, raster_cache.hits),
+                                          enif_make_ulong(env, raster_cache.misses));
+    enif_mutex_unlock(raster_cache.lock);
+
+    return stats;
+}
+
+/**
+ * Wraps cairo_recording_surface_create(
+ *  cairo_content_t content,
+ *  const cairo_rectangle_t *extents);
+ * @brief EX_recording_surface_create
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_recording_surface_create(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+
+    cairo_content_t content;
+    ERL_TRY_ATOM(0,     ET_color,       content, CAIRO_CONTENT_COLOR)
+    _ERL_TRY_ATOM(0,    ET_alpha,       content, CAIRO_CONTENT_ALPHA)
+    _ERL_TRY_ATOM(0,    ET_color_alpha, content, CAIRO_CONTENT_COLOR_ALPHA)
+    _ERL_FAIL_ATOM;
+
+    int arity = 4;
+    const ERL_NIF_TERM *tuple;
+    ERL_ASSERT(enif_get_tuple(env, argv[1], &arity, &tuple));
+
+    cairo_rectangle_t rect;
+    enif_get_double(env, tuple[0], &rect.x);
+    enif_get_double(env, tuple[1], &rect.y);
+    enif_get_double(env, tuple[2], &rect.width);
     enif_get_double(env, tuple[3], &rect.height);
 
-    ERL_MAKE_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, instance);
-    ERL_ASSERT(instance);
+    ERL_MAKE_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, instance);
+    ERL_ASSERT(instance);
+
+    instance->data = cairo_recording_surface_create(content, &rect);
+
+    // Create a garbage-collectable resource
+    ERL_MAKE_GC_RES(instance, surface);
+    return ERL_MAKE_OK_TUPLE(surface);
+}
+
+/**
+ * Wraps cairo_recording_surface_get_extents(
+ *   cairo_surface_t *surface,
+ *   cairo_rectangle_t *extents);
+ * @brief EX_recording_surface_get_extents
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_recording_surface_get_extents(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface)
+    ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
+
+    cairo_rectangle_t extents;
+    if (cairo_recording_surface_get_extents(surface->data, &extents)) {
+        return enif_make_tuple4(env,
+                                enif_make_double(env, extents.x),
+                                enif_make_double(env, extents.y),
+                                enif_make_double(env, extents.width),
+                                enif_make_double(env, extents.height));
+    } else {
+        return enif_make_badarg(env);
+    }
+}
+
+/**
+ * Wraps cairo_recording_surface_ink_extents(
+ *      cairo_surface_t *surface,
+ *      double *x0,
+ *      double *y0,
+ *      double *width,
+ *      double *height);
+ * @brief EX_recording_surface_ink_extents
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_recording_surface_ink_extents(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface)
+    ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
+
+    double x,y,w,h;
+    cairo_recording_surface_ink_extents(surface->data, &x,&y,&w,&h);
+    return enif_make_tuple4(env,
+                            enif_make_double(env, x),
+                            enif_make_double(env, y),
+                            enif_make_double(env, w),
+                            enif_make_double(env, h));
+}
+
+/**
+ * Replay a recording into a new recording surface with the same
+ * extents. Each pool worker replays its own copy, cairo builds replay
+ * state lazily and does not guard it against concurrent readers.
+ * @brief copy_recording
+ * @return the copy, NULL if it could not be made
+ */
+static cairo_surface_t *copy_recording(cairo_surface_t *recording) {
+    cairo_rectangle_t extents;
+    cairo_content_t content = cairo_surface_get_content(recording);
+    cairo_surface_t *copy = cairo_recording_surface_get_extents(recording, &extents)
+            ? cairo_recording_surface_create(content, &extents)
+            : cairo_recording_surface_create(content, NULL);
+
+    cairo_t *cr = cairo_create(copy);
+    cairo_set_source_surface(cr, recording, 0, 0);
+    cairo_paint(cr);
+    cairo_status_t status = cairo_status(cr);
+    cairo_destroy(cr);
+
+    // The paint keeps a snapshot of the recording, detach it so the
+    // next copy takes a snapshot of its own
+    cairo_surface_flush(recording);
+
+    if (status != CAIRO_STATUS_SUCCESS || cairo_surface_status(copy) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(copy);
+        return NULL;
+    }
+
+    return copy;
+}
+
+// Highest zoom level accepted by recording_surface_render_tiles
+#define TILE_MAX_ZOOM 20
+
+// Most tiles a single recording_surface_render_tiles call may render,
+// all zoom levels together
+#define TILE_MAX_COUNT (1L << 18)
+
+/**
+ * Shared state of a recording_surface_render_tiles call. Pool workers
+ * claim tile indices from `next` until all tiles are rendered. Tiles
+ * are numbered zoom level by zoom level, row by row. Every worker
+ * claims one of the `copies` of the recording to replay.
+ */
+typedef struct {
+    cairo_surface_t_TYPE *recording;
+    cairo_surface_t **copies;
+    int claimed;
+    cairo_rectangle_t extents;
+    int tile_size;
+    int min_zoom;
+    long total;
+    long next;
+    int running;
+    int workers;
+    int cancelled;
+    cairo_status_t status;
+    ErlNifMutex *lock;
+    ErlNifCond *cond;
+
+    // Collected tiles, NULL when streaming to a process
+    ErlNifBinary *tiles;
+
+    // Streaming target
+    ErlNifPid pid;
+    ErlNifEnv *msg_env;
+    ERL_NIF_TERM ref;
+} tile_batch_t;
+
+/**
+ * Position of the tile with the given index
+ * @brief tile_coordinates
+ */
+static void tile_coordinates(const tile_batch_t *batch, long index, int *z, int *x, int *y) {
+    int zoom = batch->min_zoom;
+    while (index >= (1L << (2 * zoom))) {
+        index -= 1L << (2 * zoom);
+        zoom++;
+    }
+
+    *z = zoom;
+    *x = (int) (index % (1L << zoom));
+    *y = (int) (index / (1L << zoom));
+}
+
+/**
+ * Replay the recording into a single tile and encode it as PNG. The
+ * tile surface is clipped to its own bounds, so only the commands
+ * touching the tile are rasterized.
+ * @brief render_tile
+ * @return the status of the drawing or the encoder
+ */
+static cairo_status_t render_tile(const tile_batch_t *batch, cairo_surface_t *recording, int z, int x, int y, ErlNifBinary *png) {
+    int size = batch->tile_size;
+
+    cairo_surface_t *tile = surface_pool_checkout(CAIRO_FORMAT_ARGB32, size, size, 1);
+    if (!tile) {
+        tile = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    }
+
+    // At zoom z the longer side of the extents spans 2^z tiles
+    double side = batch->extents.width > batch->extents.height ? batch->extents.width : batch->extents.height;
+    double scale = (double) size * (1L << z) / side;
+
+    cairo_t *cr = cairo_create(tile);
+    cairo_rectangle(cr, 0, 0, size, size);
+    cairo_clip(cr);
+    cairo_translate(cr, -(double) x * size, -(double) y * size);
+    cairo_scale(cr, scale, scale);
+    cairo_translate(cr, -batch->extents.x, -batch->extents.y);
+    cairo_set_source_surface(cr, recording, 0, 0);
+    cairo_paint(cr);
+
+    cairo_status_t status = cairo_status(cr);
+    cairo_destroy(cr);
+
+    if (status == CAIRO_STATUS_SUCCESS) {
+        png_buffer_t buffer;
+        status = png_encode_surface(tile, &buffer);
+        if (status == CAIRO_STATUS_SUCCESS) {
+            *png = buffer.bin;
+        }
+    }
+
+    if (!surface_pool_checkin(tile)) {
+        cairo_surface_destroy(tile);
+    }
+
+    return status;
+}
+
+/**
+ * Release everything a batch holds. Tiles that were rendered but not
+ * handed out are released as well.
+ * @brief tile_batch_free
+ */
+static void tile_batch_free(tile_batch_t *batch) {
+    if (batch->tiles) {
+        long i;
+        for (i = 0; i < batch->total; i++) {
+            if (batch->tiles[i].data) {
+                enif_release_binary(&batch->tiles[i]);
+            }
+        }
+        enif_free(batch->tiles);
+    }
+
+    if (batch->copies) {
+        int i;
+        for (i = 0; i < batch->workers; i++) {
+            if (batch->copies[i]) {
+                cairo_surface_destroy(batch->copies[i]);
+            }
+        }
+        enif_free(batch->copies);
+    }
+
+    if (batch->msg_env) {
+        enif_free_env(batch->msg_env);
+    }
+
+    if (batch->recording) {
+        enif_release_resource(batch->recording);
+    }
+
+    enif_cond_destroy(batch->cond);
+    enif_mutex_destroy(batch->lock);
+    enif_free(batch);
+}
+
+/**
+ * Called once per worker when it stops. The last worker of a streaming
+ * batch sends {:excairo_tiles_done, ref, result} and frees the batch,
+ * otherwise the waiting caller is woken up.
+ * @brief tile_worker_done
+ */
+static void tile_worker_done(tile_batch_t *batch) {
+    enif_mutex_lock(batch->lock);
+    int last = --batch->running == 0;
+    if (last) {
+        enif_cond_broadcast(batch->cond);
+    }
+    enif_mutex_unlock(batch->lock);
+
+    if (last && !batch->tiles) {
+        // The receiver may use the recording as soon as it sees the result
+        resource_unlock(&batch->recording->lock);
+
+        ErlNifEnv *env = batch->msg_env;
+        ERL_NIF_TERM result = batch->status == CAIRO_STATUS_SUCCESS
+                ? enif_make_atom(env, "ok")
+                : enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, batch->status));
+
+        enif_send(NULL, &batch->pid, env,
+                  enif_make_tuple3(env, enif_make_atom(env, "excairo_tiles_done"), batch->ref, result));
+
+        tile_batch_free(batch);
+    }
+}
+
+/**
+ * Runs on a pool thread: renders tiles until none are left. Streamed
+ * tiles are sent as {:excairo_tile, ref, {z, x, y}, png}; once the
+ * receiver is gone the remaining tiles are skipped.
+ * @brief run_tile_worker
+ * @param arg a tile_batch_t
+ */
+static void run_tile_worker(void *arg) {
+    tile_batch_t *batch = (tile_batch_t *) arg;
+
+    enif_mutex_lock(batch->lock);
+    cairo_surface_t *recording = batch->status == CAIRO_STATUS_SUCCESS ? batch->copies[batch->claimed++] : NULL;
+    enif_mutex_unlock(batch->lock);
+
+    for (;;) {
+        enif_mutex_lock(batch->lock);
+        long index = batch->status == CAIRO_STATUS_SUCCESS && !batch->cancelled &&
+                batch->next < batch->total ? batch->next++ : -1;
+        enif_mutex_unlock(batch->lock);
+
+        if (index < 0) {
+            break;
+        }
+
+        int z, x, y;
+        tile_coordinates(batch, index, &z, &x, &y);
+
+        ErlNifBinary png;
+        cairo_status_t status = render_tile(batch, recording, z, x, y, &png);
+        if (status != CAIRO_STATUS_SUCCESS) {
+            enif_mutex_lock(batch->lock);
+            batch->status = status;
+            enif_mutex_unlock(batch->lock);
+            break;
+        }
+
+        if (batch->tiles) {
+            batch->tiles[index] = png;
+        } else {
+            ErlNifEnv *env = enif_alloc_env();
+            int sent = enif_send(NULL, &batch->pid, env,
+                                 enif_make_tuple4(env,
+                                                  enif_make_atom(env, "excairo_tile"),
+                                                  enif_make_copy(env, batch->ref),
+                                                  enif_make_tuple3(env, enif_make_int(env, z), enif_make_int(env, x), enif_make_int(env, y)),
+                                                  enif_make_binary(env, &png)));
+            enif_free_env(env);
+
+            if (!sent) {
+                enif_mutex_lock(batch->lock);
+                batch->cancelled = 1;
+                enif_mutex_unlock(batch->lock);
+                break;
+            }
+        }
+    }
+
+    tile_worker_done(batch);
+}
+
+/**
+ * Runs on a pool thread as the first worker of a batch: measures the
+ * recording, replays it into one copy per worker and queues the other
+ * workers before rendering tiles itself
+ * @brief run_tile_lead
+ * @param arg a tile_batch_t
+ */
+static void run_tile_lead(void *arg) {
+    tile_batch_t *batch = (tile_batch_t *) arg;
+    cairo_surface_t *recording = batch->recording->data;
+    int i;
+
+    if (!cairo_recording_surface_get_extents(recording, &batch->extents)) {
+        // Unbounded recording, tile what was actually drawn
+        cairo_recording_surface_ink_extents(recording,
+                                            &batch->extents.x, &batch->extents.y,
+                                            &batch->extents.width, &batch->extents.height);
+    }
+
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    if (batch->extents.width <= 0 || batch->extents.height <= 0) {
+        status = CAIRO_STATUS_INVALID_SIZE;
+    } else {
+        batch->copies = enif_alloc(sizeof(cairo_surface_t *) * batch->workers);
+        if (batch->copies) {
+            memset(batch->copies, 0, sizeof(cairo_surface_t *) * batch->workers);
+            for (i = 0; i < batch->workers && status == CAIRO_STATUS_SUCCESS; i++) {
+                batch->copies[i] = copy_recording(recording);
+                if (!batch->copies[i]) {
+                    status = CAIRO_STATUS_NO_MEMORY;
+                }
+            }
+        } else {
+            status = CAIRO_STATUS_NO_MEMORY;
+        }
+    }
+
+    // Workers read the status under the lock as soon as they are queued
+    enif_mutex_lock(batch->lock);
+    batch->status = status;
+    enif_mutex_unlock(batch->lock);
+
+    // Workers that are not needed or could not be queued are accounted
+    // as finished right away, the lead itself still counts as running
+    for (i = 1; i < batch->workers; i++) {
+        if (status != CAIRO_STATUS_SUCCESS || !pool_submit(run_tile_worker, batch)) {
+            status = CAIRO_STATUS_NO_MEMORY;
+            enif_mutex_lock(batch->lock);
+            if (batch->status == CAIRO_STATUS_SUCCESS) {
+                batch->status = CAIRO_STATUS_NO_MEMORY;
+            }
+            enif_mutex_unlock(batch->lock);
+            tile_worker_done(batch);
+        }
+    }
+
+    run_tile_worker(batch);
+}
+
+/**
+ * Allocate an empty batch. The recording is not looked at, so this can
+ * run before its lock is taken.
+ * @brief tile_batch_alloc
+ * @return the batch or NULL if memory ran out
+ */
+static tile_batch_t *tile_batch_alloc(void) {
+    tile_batch_t *batch = enif_alloc(sizeof(tile_batch_t));
+    if (!batch) {
+        return NULL;
+    }
+    memset(batch, 0, sizeof(tile_batch_t));
+
+    batch->lock = enif_mutex_create("excairo_tile_batch_lock");
+    batch->cond = enif_cond_create("excairo_tile_batch_cond");
+    if (!batch->lock || !batch->cond) {
+        if (batch->lock) enif_mutex_destroy(batch->lock);
+        if (batch->cond) enif_cond_destroy(batch->cond);
+        enif_free(batch);
+        return NULL;
+    }
+
+    return batch;
+}
+
+/**
+ * Validate the arguments of recording_surface_render_tiles and set up
+ * a batch. The recording is kept alive by the batch; measuring and
+ * replaying it is left to the lead worker on the pool.
+ * @brief tile_batch_setup
+ * @return 1 on success, 0 on invalid arguments
+ */
+static int tile_batch_setup(ErlNifEnv *env, const ERL_NIF_TERM argv[], tile_batch_t *batch, cairo_surface_t_TYPE *recording) {
+    int tile_size, min_zoom, max_zoom;
+    if (!enif_get_int(env, argv[1], &tile_size) ||
+        !enif_get_int(env, argv[2], &min_zoom) ||
+        !enif_get_int(env, argv[3], &max_zoom) ||
+        tile_size <= 0 || min_zoom < 0 || max_zoom < min_zoom || max_zoom > TILE_MAX_ZOOM ||
+        cairo_surface_get_type(recording->data) != CAIRO_SURFACE_TYPE_RECORDING) {
+        return 0;
+    }
+
+    int z;
+    for (z = min_zoom; z <= max_zoom; z++) {
+        batch->total += 1L << (2 * z);
+    }
+    if (batch->total > TILE_MAX_COUNT) {
+        return 0;
+    }
+
+    batch->recording = recording;
+    batch->tile_size = tile_size;
+    batch->min_zoom = min_zoom;
+    batch->status = CAIRO_STATUS_SUCCESS;
+    enif_keep_resource(recording);
+
+    return 1;
+}
+
+/**
+ * Hand a batch to the pool, one worker per pool thread. Only the lead
+ * worker is queued here, it queues the others. If it can't be queued
+ * the batch fails and all workers are accounted as finished, so a
+ * streaming batch may already be gone when this returns.
+ * @brief tile_batch_start
+ */
+static void tile_batch_start(tile_batch_t *batch) {
+    int workers = pool.num_threads;
+    if (batch->total < workers) {
+        workers = (int) batch->total;
+    }
+
+    // Count workers up front, a fast one could finish before the rest is queued
+    batch->running = workers;
+    batch->workers = workers;
+
+    if (!pool_submit(run_tile_lead, batch)) {
+        enif_mutex_lock(batch->lock);
+        batch->status = CAIRO_STATUS_NO_MEMORY;
+        enif_mutex_unlock(batch->lock);
+
+        int i;
+        for (i = 0; i < workers; i++) {
+            tile_worker_done(batch);
+        }
+    }
+}
+
+/**
+ * Renders a recording surface into a tile pyramid on the worker pool
+ * and collects the PNG encoded tiles.
+ * -> Runs on a dirty CPU scheduler, waiting for the workers
+ * @brief EX_recording_surface_render_tiles_dirty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_recording_surface_render_tiles_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(4);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, recording);
+    ERL_ASSERT(recording);
+    ERL_LOCK_INSTANCE(recording);
+
+    tile_batch_t *batch = tile_batch_alloc();
+    ERL_ASSERT(batch);
+    if (!tile_batch_setup(env, argv, batch, recording)) {
+        tile_batch_free(batch);
+        return enif_make_badarg(env);
+    }
+
+    batch->tiles = enif_alloc(sizeof(ErlNifBinary) * batch->total);
+    if (!batch->tiles) {
+        tile_batch_free(batch);
+        return enif_make_badarg(env);
+    }
+    memset(batch->tiles, 0, sizeof(ErlNifBinary) * batch->total);
+
+    tile_batch_start(batch);
+
+    enif_mutex_lock(batch->lock);
+    while (batch->running > 0) {
+        enif_cond_wait(batch->cond, batch->lock);
+    }
+    enif_mutex_unlock(batch->lock);
+
+    if (batch->status != CAIRO_STATUS_SUCCESS) {
+        ERL_NIF_TERM error = enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, batch->status));
+        tile_batch_free(batch);
+        return error;
+    }
+
+    // Build the list back to front so it comes out in tile order
+    ERL_NIF_TERM list = enif_make_list(env, 0);
+    long i;
+    for (i = batch->total - 1; i >= 0; i--) {
+        int z, x, y;
+        tile_coordinates(batch, i, &z, &x, &y);
+        list = enif_make_list_cell(env, enif_make_tuple4(env,
+                                       enif_make_int(env, z),
+                                       enif_make_int(env, x),
+                                       enif_make_int(env, y),
+                                       enif_make_binary(env, &batch->tiles[i])), list);
+        batch->tiles[i].data = NULL;
+    }
+
+    tile_batch_free(batch);
+    return ERL_MAKE_OK_TUPLE(list);
+}
+
+/**
+ * Renders a recording surface into a z/x/y tile pyramid of PNG
+ * encoded tiles of tile_size pixels, for all zoom levels between
+ * min_zoom and max_zoom. At zoom z the longer side of the recording
+ * extents spans 2^z tiles. Tiles are rendered in parallel on the
+ * native worker pool. At most TILE_MAX_COUNT tiles are rendered per
+ * call.
+ * -> With 4 arguments the call returns {:ok, [{z, x, y, png}]}
+ * -> With a pid as 5th argument it returns {:ok, ref} right away and
+ * the tiles are sent as {:excairo_tile, ref, {z, x, y}, png}, followed
+ * by {:excairo_tiles_done, ref, :ok | {:error, status}}
+ * @brief EX_recording_surface_render_tiles
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_recording_surface_render_tiles(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT(argc == 4 || argc == 5);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, recording);
+    ERL_ASSERT(recording);
+
+    if (argc == 4) {
+        return enif_schedule_nif(env, "recording_surface_render_tiles", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                                 EX_recording_surface_render_tiles_dirty, argc, argv);
+    }
+
+    ErlNifPid pid;
+    ERL_ASSERT(enif_get_local_pid(env, argv[4], &pid));
+
+    tile_batch_t *batch = tile_batch_alloc();
+    ERL_ASSERT(batch);
+
+    // The batch owns the lock until the last tile has been sent, it is
+    // taken before the recording is looked at
+    if (!resource_trylock(&recording->lock, (unsigned long) batch)) {
+        tile_batch_free(batch);
+        return ERL_BUSY;
+    }
+    if (!tile_batch_setup(env, argv, batch, recording)) {
+        resource_unlock(&recording->lock);
+        tile_batch_free(batch);
+        return enif_make_badarg(env);
+    }
+
+    batch->pid = pid;
+    batch->msg_env = enif_alloc_env();
+    batch->ref = enif_make_ref(batch->msg_env);
+
+    ERL_NIF_TERM ref = enif_make_copy(env, batch->ref);
+    tile_batch_start(batch);
+
+    return ERL_MAKE_OK_TUPLE(ref);
+}
+
+/**
+ * Wraps cairo_rectangle(
+ *      cairo_t *cr,
+ *      double x,
+ *      double y,
+ *      double width,
+ *      double height);
+ * @brief EX_rectangle
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_rectangle(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(5);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+
+    double x,y,w,h;
+    enif_get_double(env, argv[1], &x);
+    enif_get_double(env, argv[2], &y);
+    enif_get_double(env, argv[3], &w);
+    enif_get_double(env, argv[4], &h);
+
+    cairo_rectangle(context->data, x, y, w, h);
+
+    return ERL_OK;
+}
+
+/**
+ * Wraps cairo_region_contains_point(const cairo_region_t *region,
+                                                         int x,
+                                                         int y);
+ * @brief EX_region_contains_point
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_contains_point(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(3);
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, region);
+    ERL_ASSERT(region);
+
+    ERL_GET_INT(1, x);
+    ERL_GET_INT(2, y);
+
+    ERL_LOCK_INSTANCE(region);
+    cairo_bool_t result = cairo_region_contains_point(region->data, x, y);
+    return ERL_BOOL(result);
+}
+
+/**
+ * Wraps cairo_region_contains_rectangle(
+ *  const cairo_region_t *region,
+ *  const cairo_rectangle_int_t *rectangle);
+ * @brief EX_region_contains_point
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_contains_rectangle(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, region);
+    ERL_ASSERT(region);
+
+    int arity;
+    const ERL_NIF_TERM *tuple;
+    ERL_ASSERT(enif_get_tuple(env, argv[1], &arity, &tuple) && arity == 4);
+
+    cairo_rectangle_int_t rect;
+
+    ERL_ASSERT(enif_get_int(env, tuple[0], &rect.x));
+    ERL_ASSERT(enif_get_int(env, tuple[1], &rect.y));
+    ERL_ASSERT(enif_get_int(env, tuple[2], &rect.width));
+    ERL_ASSERT(enif_get_int(env, tuple[3], &rect.height));
+
+    ERL_LOCK_INSTANCE(region);
+    cairo_region_overlap_t result = cairo_region_contains_rectangle(region->data, &rect);
+    switch (result) {
+    case CAIRO_REGION_OVERLAP_IN:
+        return enif_make_atom(env, "in");
+    case CAIRO_REGION_OVERLAP_OUT:
+        return enif_make_atom(env, "out");
+    case CAIRO_REGION_OVERLAP_PART:
+        return enif_make_atom(env, "part");
+    default:
+        return enif_make_badarg(env);
+    }
+}
+
+/**
+ * Wraps cairo_region_copy(const cairo_region_t *original)
+ * @brief EX_region_copy
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_copy(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, region);
+    ERL_ASSERT(region);
+    ERL_LOCK_INSTANCE(region);
+
+    return make_region(env, cairo_region_copy(region->data));
+}
+
+/**
+ * Wraps cairo_region_create(void)
+ * @brief EX_region_create
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_create(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(0);
+    return make_region(env, cairo_region_create());
+}
+
+/**
+ * Wraps cairo_region_create_rectangles(const cairo_rectangle_int_t *rects, int count)
+ * -> The rectangles are a packed binary of
+ * <<x::32, y::32, width::32, height::32>> signed integers
+ * @brief EX_region_create_rectangles
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_create_rectangles(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+
+    ErlNifBinary bin;
+    ERL_ASSERT(enif_inspect_binary(env, argv[0], &bin));
+
+    cairo_region_t *region = read_packed_region(&bin);
+    ERL_ASSERT(region);
+
+    return make_region(env, region);
+}
+
+/**
+ * Wraps cairo_region_equal(const cairo_region_t *a, const cairo_region_t *b)
+ * @brief EX_region_equal
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_equal(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, a);
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 1, b);
+    ERL_ASSERT(a && b);
+    ERL_LOCK_INSTANCE(a);
+    ERL_LOCK_INSTANCE(b);
+
+    cairo_bool_t result = cairo_region_equal(a->data, b->data);
+    return ERL_BOOL(result);
+}
+
+/**
+ * Wraps cairo_region_get_extents(const cairo_region_t *region, cairo_rectangle_int_t *extents)
+ * -> Returns {x, y, width, height}
+ * @brief EX_region_get_extents
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_get_extents(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, region);
+    ERL_ASSERT(region);
+    ERL_LOCK_INSTANCE(region);
+
+    cairo_rectangle_int_t rect;
+    cairo_region_get_extents(region->data, &rect);
+
+    return enif_make_tuple4(env,
+                            enif_make_int(env, rect.x),
+                            enif_make_int(env, rect.y),
+                            enif_make_int(env, rect.width),
+                            enif_make_int(env, rect.height));
+}
+
+/**
+ * Wraps cairo_region_get_rectangle(const cairo_region_t *region, int nth, cairo_rectangle_int_t *rectangle)
+ * -> Returns all rectangles at once as a packed binary of
+ * <<x::32, y::32, width::32, height::32>> signed integers
+ * @brief EX_region_get_rectangles
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_get_rectangles(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, region);
+    ERL_ASSERT(region);
+    ERL_LOCK_INSTANCE(region);
+
+    return make_packed_region(env, region->data);
+}
+
+/**
+ * Combines a region in place with the region or packed rectangles in
+ * argv[1]
+ * @brief region_combine
+ * @return :ok or {:error, status}
+ */
+static ERL_NIF_TERM region_combine(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[],
+                                   cairo_status_t (*combine)(cairo_region_t *, const cairo_region_t *)) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, region);
+    ERL_ASSERT(region);
+
+    cairo_region_t *temporary = NULL;
+    const cairo_region_t *other;
+
+    resource_lock_t *other_lock __attribute__((cleanup(release_scoped_lock))) = NULL;
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 1, other_region);
+    if (other_region) {
+        if (!resource_trylock(&other_region->lock, LOCK_THREAD_TOKEN)) {
+            return ERL_BUSY;
+        }
+        other_lock = &other_region->lock;
+        other = other_region->data;
+    } else {
+        ErlNifBinary bin;
+        ERL_ASSERT(enif_inspect_binary(env, argv[1], &bin));
+        temporary = read_packed_region(&bin);
+        ERL_ASSERT(temporary);
+        other = temporary;
+    }
+
+    cairo_status_t status;
+    if (resource_trylock(&region->lock, LOCK_THREAD_TOKEN)) {
+        status = combine(region->data, other);
+        resource_unlock(&region->lock);
+    } else {
+        if (temporary) {
+            cairo_region_destroy(temporary);
+        }
+        return ERL_BUSY;
+    }
+
+    if (temporary) {
+        cairo_region_destroy(temporary);
+    }
+
+    if (status != CAIRO_STATUS_SUCCESS) {
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, status));
+    }
+
+    return ERL_OK;
+}
+
+/**
+ * Wraps cairo_region_intersect(cairo_region_t *dst, const cairo_region_t *other)
+ * -> other is a region or a packed binary of rectangles
+ * @brief EX_region_intersect
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_intersect(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    return region_combine(env, argc, argv, cairo_region_intersect);
+}
+
+/**
+ * Wraps cairo_region_is_empty(const cairo_region_t *region)
+ * @brief EX_region_is_empty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_is_empty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, region);
+    ERL_ASSERT(region);
+    ERL_LOCK_INSTANCE(region);
+
+    cairo_bool_t result = cairo_region_is_empty(region->data);
+    return ERL_BOOL(result);
+}
+
+/**
+ * Wraps cairo_region_num_rectangles(const cairo_region_t *region)
+ * @brief EX_region_num_rectangles
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_num_rectangles(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, region);
+    ERL_ASSERT(region);
+    ERL_LOCK_INSTANCE(region);
+
+    return enif_make_int(env, cairo_region_num_rectangles(region->data));
+}
+
+/**
+ * Wraps cairo_region_subtract(cairo_region_t *dst, const cairo_region_t *other)
+ * -> other is a region or a packed binary of rectangles
+ * @brief EX_region_subtract
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_subtract(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    return region_combine(env, argc, argv, cairo_region_subtract);
+}
+
+/**
+ * Wraps cairo_region_translate(cairo_region_t *region, int dx, int dy)
+ * @brief EX_region_translate
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_translate(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(3);
+    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, region);
+    ERL_ASSERT(region);
+
+    ERL_GET_INT(1, dx);
+    ERL_GET_INT(2, dy);
+
+    ERL_LOCK_INSTANCE(region);
+    cairo_region_translate(region->data, dx, dy);
+    return ERL_OK;
+}
+
+/**
+ * Wraps cairo_region_union(cairo_region_t *dst, const cairo_region_t *other)
+ * -> other is a region or a packed binary of rectangles
+ * @brief EX_region_union
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_union(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    return region_combine(env, argc, argv, cairo_region_union);
+}
+
+/**
+ * Wraps cairo_region_xor(cairo_region_t *dst, const cairo_region_t *other)
+ * -> other is a region or a packed binary of rectangles
+ * @brief EX_region_xor
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_region_xor(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    return region_combine(env, argc, argv, cairo_region_xor);
+}
+
+
+/**
+ * State of a render job submitted with `render_async`. The job holds
+ * a reference on both resources so they can't be collected while a
+ * worker thread is drawing, and owns their locks until it is done.
+ */
+typedef struct {
+    cairo_t_TYPE *context;
+    cairo_surface_t_TYPE *surface;
+    draw_op_t *ops;
+    size_t count;
+    ErlNifPid pid;
+    ErlNifEnv *msg_env;
+    ERL_NIF_TERM ref;
+} render_job_t;
+
+/**
+ * Runs on a pool thread: applies the operations and sends
+ * {:excairo_done, ref, :ok | {:error, index}} to the caller
+ * @brief run_render_job
+ * @param arg a render_job_t
+ */
+static void run_render_job(void *arg) {
+    render_job_t *job = (render_job_t *) arg;
+    ErlNifEnv *env = job->msg_env;
+
+    int failed = apply_ops(job->context->data, job->ops, job->count);
+    cairo_surface_flush(job->surface->data);
+
+    // The receiver may draw again as soon as it sees the result
+    resource_unlock(&job->context->lock);
+    resource_unlock(&job->surface->lock);
+    enif_release_resource(job->context);
+    enif_release_resource(job->surface);
+
+    ERL_NIF_TERM result = failed < 0
+            ? enif_make_atom(env, "ok")
+            : enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, failed));
+
+    enif_send(NULL, &job->pid, env,
+              enif_make_tuple3(env, enif_make_atom(env, "excairo_done"), job->ref, result));
+
+    enif_free_env(job->msg_env);
+    enif_free(job->ops);
+    enif_free(job);
+}
+
+/**
+ * Applies a batch of draw operations (see `execute`) on a native
+ * worker thread. The context must target the given surface.
+ * -> Returns {:ok, ref} immediately. When the job is done
+ * {:excairo_done, ref, result} is sent to the calling process where
+ * result is :ok or {:error, index}. A malformed batch is rejected
+ * right away with {:error, index}, {:error, :busy} is returned if the
+ * context or the surface is in use.
+ * @brief EX_render_async
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_render_async(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(3);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
+    ERL_ASSERT(surface);
+
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 1, context);
+    ERL_ASSERT(context);
+    ERL_ASSERT(context->target == surface);
+
+    draw_op_t *ops;
+    size_t count;
+    int failed;
+    if (!decode_ops(env, argv[2], &ops, &count, &failed)) {
+        ERL_ASSERT(failed >= 0);
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, failed));
+    }
+
+    render_job_t *job = enif_alloc(sizeof(render_job_t));
+    if (!job) {
+        enif_free(ops);
+        return enif_make_badarg(env);
+    }
+
+    // The job owns both locks until the worker has finished
+    if (!resource_trylock(&context->lock, (unsigned long) job)) {
+        enif_free(ops);
+        enif_free(job);
+        return ERL_BUSY;
+    }
+    if (!resource_trylock(&surface->lock, (unsigned long) job)) {
+        resource_unlock(&context->lock);
+        enif_free(ops);
+        enif_free(job);
+        return ERL_BUSY;
+    }
+    raster_cache_invalidate(surface->data);
+
+    job->context = context;
+    job->surface = surface;
+    job->ops = ops;
+    job->count = count;
+    job->msg_env = enif_alloc_env();
+    job->ref = enif_make_ref(job->msg_env);
+    enif_self(env, &job->pid);
+
+    // Keep both resources alive until the job has finished
+    enif_keep_resource(context);
+    enif_keep_resource(surface);
+
+    ERL_NIF_TERM ref = enif_make_copy(env, job->ref);
+
+    if (!pool_submit(run_render_job, job)) {
+        resource_unlock(&context->lock);
+        resource_unlock(&surface->lock);
+        enif_release_resource(context);
+        enif_release_resource(surface);
+        enif_free_env(job->msg_env);
+        enif_free(ops);
+        enif_free(job);
+        return enif_make_badarg(env);
+    }
+
+    return ERL_MAKE_OK_TUPLE(ref);
+}
+
+// Bands are at least this many rows high
+#define BAND_MIN_HEIGHT 16
+
+/**
+ * Shared state of a render_bands call. Every band job draws the whole
+ * source into its own slice of the target; the caller waits until
+ * `running` drops to zero.
+ */
+typedef struct {
+    cairo_surface_t *target;
+    const display_list_t_TYPE *list;
+    int running;
+    int failed;
+    cairo_status_t status;
+    ErlNifMutex *lock;
+    ErlNifCond *cond;
+} band_batch_t;
+
+/**
+ * One horizontal band of the target, drawn from its own copy of the
+ * recording if the source is one
+ */
+typedef struct {
+    band_batch_t *batch;
+    cairo_surface_t *recording;
+    int y;
+    int height;
+} band_job_t;
+
+/**
+ * Runs on a pool thread: draws the source into one band. The band is
+ * an image surface over the rows of the target, so the pixels land in
+ * place and nothing has to be composed afterwards.
+ * @brief run_band_job
+ * @param arg a band_job_t
+ */
+static void run_band_job(void *arg) {
+    band_job_t *job = (band_job_t *) arg;
+    band_batch_t *batch = job->batch;
+
+    cairo_surface_t *target = batch->target;
+    int stride = cairo_image_surface_get_stride(target);
+
+    cairo_surface_t *band = cairo_image_surface_create_for_data(
+                cairo_image_surface_get_data(target) + (size_t) job->y * stride,
+                cairo_image_surface_get_format(target),
+                cairo_image_surface_get_width(target),
+                job->height,
+                stride);
+
+    cairo_t *cr = cairo_create(band);
+    cairo_translate(cr, 0, -job->y);
+
+    int failed = -1;
+    if (job->recording) {
+        cairo_set_source_surface(cr, job->recording, 0, 0);
+        cairo_paint(cr);
+    } else {
+        failed = apply_ops(cr, batch->list->ops, batch->list->count);
+    }
+
+    cairo_status_t status = cairo_status(cr);
+    cairo_destroy(cr);
+    cairo_surface_finish(band);
+    cairo_surface_destroy(band);
+
+    enif_mutex_lock(batch->lock);
+    if (status != CAIRO_STATUS_SUCCESS && batch->status == CAIRO_STATUS_SUCCESS) {
+        batch->status = status;
+    }
+    if (failed >= 0 && (batch->failed < 0 || failed < batch->failed)) {
+        batch->failed = failed;
+    }
+    if (--batch->running == 0) {
+        enif_cond_broadcast(batch->cond);
+    }
+    enif_mutex_unlock(batch->lock);
+}
+
+/**
+ * Release the band jobs of a render_bands call and their copies of the
+ * recording
+ * @brief band_jobs_free
+ */
+static void band_jobs_free(band_job_t *jobs, int bands) {
+    int i;
+    for (i = 0; i < bands; i++) {
+        if (jobs[i].recording) {
+            cairo_surface_destroy(jobs[i].recording);
+        }
+    }
+    enif_free(jobs);
+}
+
+/**
+ * Creates an image surface and draws a recording surface or a display
+ * list into it, splitting the image into horizontal bands that are
+ * drawn in parallel on the native worker pool.
+ * -> Runs on a dirty CPU scheduler, waiting for the workers
+ * @brief EX_render_bands_dirty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_render_bands_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(4);
+
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, recording);
+    ERL_GET_INSTANCE(display_list_t_TYPE, display_list_t_RT, 0, list);
+    ERL_ASSERT(recording || list);
+
+    cairo_format_t format = -1;
+    ERL_TRY_ATOM(1, ET_argb32,      format, 0)
+    _ERL_TRY_ATOM(1, ET_rgb24,       format, 1)
+    _ERL_TRY_ATOM(1, ET_a8,          format, 2)
+    _ERL_TRY_ATOM(1, ET_a1,          format, 3)
+    _ERL_TRY_ATOM(1, ET_rgb16_565,   format, 4)
+    _ERL_TRY_ATOM(1, ET_rgb30,       format, 5)
+    _ERL_FAIL_ATOM;
+
+    ERL_GET_INT(2, width);
+    ERL_GET_INT(3, height);
+    ERL_ASSERT(width > 0 && height > 0);
+
+    resource_lock_t *recording_lock __attribute__((cleanup(release_scoped_lock))) = NULL;
+    if (recording) {
+        ERL_ASSERT(cairo_surface_get_type(recording->data) == CAIRO_SURFACE_TYPE_RECORDING);
+        if (!resource_trylock(&recording->lock, LOCK_THREAD_TOKEN)) {
+            return ERL_BUSY;
+        }
+        recording_lock = &recording->lock;
+    }
+
+    cairo_surface_t *target = surface_pool_checkout(format, width, height, 1);
+    if (!target) {
+        target = cairo_image_surface_create(format, width, height);
+    }
+    if (cairo_surface_status(target) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(target);
+        return enif_make_badarg(env);
+    }
+    cairo_surface_flush(target);
+
+    // Two bands per worker evens out bands of uneven complexity
+    int bands = pool.num_threads * 2;
+    if (bands > height / BAND_MIN_HEIGHT) {
+        bands = height / BAND_MIN_HEIGHT;
+    }
+    if (bands < 1) {
+        bands = 1;
+    }
+    int band_height = (height + bands - 1) / bands;
+
+    band_batch_t batch;
+    memset(&batch, 0, sizeof(band_batch_t));
+    batch.target = target;
+    batch.list = list;
+    batch.failed = -1;
+    batch.status = CAIRO_STATUS_SUCCESS;
+    batch.lock = enif_mutex_create("excairo_band_batch_lock");
+    batch.cond = enif_cond_create("excairo_band_batch_cond");
+
+    band_job_t *jobs = enif_alloc(sizeof(band_job_t) * bands);
+    int copied = 0;
+    if (jobs) {
+        memset(jobs, 0, sizeof(band_job_t) * bands);
+        for (copied = 0; recording && copied < bands; copied++) {
+            jobs[copied].recording = copy_recording(recording->data);
+            if (!jobs[copied].recording) {
+                break;
+            }
+        }
+    }
+    if (!batch.lock || !batch.cond || !jobs || (recording && copied < bands)) {
+        if (batch.lock) enif_mutex_destroy(batch.lock);
+        if (batch.cond) enif_cond_destroy(batch.cond);
+        if (jobs) {
+            band_jobs_free(jobs, bands);
+        }
+        cairo_surface_destroy(target);
+        return enif_make_badarg(env);
+    }
+
+    // Count all bands up front, a fast one could finish before the rest is queued
+    batch.running = bands;
+
+    int i;
+    for (i = 0; i < bands; i++) {
+        jobs[i].batch = &batch;
+        jobs[i].y = i * band_height;
+        jobs[i].height = height - jobs[i].y < band_height ? height - jobs[i].y : band_height;
+
+        if (jobs[i].height <= 0 || !pool_submit(run_band_job, &jobs[i])) {
+            // Draw on this thread instead
+            if (jobs[i].height > 0) {
+                run_band_job(&jobs[i]);
+            } else {
+                enif_mutex_lock(batch.lock);
+                batch.running--;
+                enif_mutex_unlock(batch.lock);
+            }
+        }
+    }
+
+    enif_mutex_lock(batch.lock);
+    while (batch.running > 0) {
+        enif_cond_wait(batch.cond, batch.lock);
+    }
+    enif_mutex_unlock(batch.lock);
+
+    enif_cond_destroy(batch.cond);
+    enif_mutex_destroy(batch.lock);
+    band_jobs_free(jobs, bands);
+
+    cairo_surface_mark_dirty(target);
+
+    if (batch.failed >= 0 || batch.status != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(target);
+        ERL_NIF_TERM reason = batch.failed >= 0
+                ? enif_make_tuple2(env, enif_make_atom(env, "op"), enif_make_int(env, batch.failed))
+                : enif_make_tuple2(env, enif_make_atom(env, "status"), enif_make_int(env, batch.status));
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), reason);
+    }
+
+    ERL_MAKE_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, instance);
+    if (!instance) {
+        cairo_surface_destroy(target);
+        return enif_make_badarg(env);
+    }
+
+    instance->data = target;
+
+    // Create a garbage-collectable resource
+    ERL_MAKE_GC_RES(instance, surface);
+    return ERL_MAKE_OK_TUPLE(surface);
+}
+
+/**
+ * Draws a recording surface or a display list into a new image
+ * surface of the given format and size. The image is split into
+ * horizontal bands that are drawn concurrently on the worker pool.
+ * -> Returns {:ok, surface}, or {:error, {:op, index}} for the first
+ * display list operation that failed, or {:error, {:status, status}}
+ * if cairo reported an error status
+ * @brief EX_render_bands
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_render_bands(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(4);
+
+    return enif_schedule_nif(env, "render_bands", ERL_NIF_DIRTY_JOB_CPU_BOUND,
+                             EX_render_bands_dirty, argc, argv);
+}
+
+/**
+ * Wraps cairo_image_surface_create(cairo_format_t format, int width, int height)
+ * -> Reuses a pooled surface of the same shape if one is available
+ * @brief EX_image_surface_create
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_image_surface_create(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(3);
+
+    cairo_format_t format = -1;
+    ERL_TRY_ATOM(0, ET_invalid,      format, -1)
+    _ERL_TRY_ATOM(0, ET_argb32,      format, 0)
+    _ERL_TRY_ATOM(0, ET_rgb24,       format, 1)
+    _ERL_TRY_ATOM(0, ET_a8,          format, 2)
+    _ERL_TRY_ATOM(0, ET_a1,          format, 3)
+    _ERL_TRY_ATOM(0, ET_rgb16_565,   format, 4)
+    _ERL_TRY_ATOM(0, ET_rgb30,       format, 5)
+    _ERL_FAIL_ATOM;
+
+    ERL_GET_INT(1, width);
+    ERL_GET_INT(2, height);
+
+    ERL_MAKE_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, instance);
+    ERL_ASSERT(instance);
+
+    instance->data = surface_pool_checkout(format, width, height, 1);
+    if (!instance->data) {
+        instance->data = cairo_image_surface_create(format, width, height);
+    }
+
+    // Create a garbage-collectable resource
+    ERL_MAKE_GC_RES(instance, surface);
+    return ERL_MAKE_OK_TUPLE(surface);
+}
+
+/**
+ * Wraps cairo_image_surface_create_for_data(unsigned char *data,
+ *   cairo_format_t format,
+ *   int width,
+ *   int height,
+ *   int stride)
+ * -> Erlang binaries are immutable, so the pixels are copied once into
+ * a buffer owned by the surface and released together with it
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_image_surface_create_for_data_dirty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_image_surface_create_for_data_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(5);
+
+    ErlNifBinary bin;
+    ERL_ASSERT(enif_inspect_binary(env, argv[0], &bin));
+
+    cairo_format_t format = -1;
+    ERL_TRY_ATOM(1, ET_argb32,      format, 0)
+    _ERL_TRY_ATOM(1, ET_rgb24,       format, 1)
+    _ERL_TRY_ATOM(1, ET_a8,          format, 2)
+    _ERL_TRY_ATOM(1, ET_a1,          format, 3)
+    _ERL_TRY_ATOM(1, ET_rgb16_565,   format, 4)
+    _ERL_TRY_ATOM(1, ET_rgb30,       format, 5)
+    _ERL_FAIL_ATOM;
+
+    ERL_GET_INT(2, width);
+    ERL_GET_INT(3, height);
+    ERL_GET_INT(4, stride);
+
+    ERL_ASSERT(width > 0 && height > 0);
+    ERL_ASSERT(stride >= cairo_format_stride_for_width(format, width));
+
+    size_t size = (size_t) stride * height;
+    ERL_ASSERT(bin.size >= size);
+
+    unsigned char *pixels = enif_alloc(size);
+    ERL_ASSERT(pixels);
+    memcpy(pixels, bin.data, size);
+
+    cairo_surface_t *data = cairo_image_surface_create_for_data(pixels, format, width, height, stride);
+    if (cairo_surface_status(data) != CAIRO_STATUS_SUCCESS ||
+        cairo_surface_set_user_data(data, &surface_data_key, pixels, enif_free) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(data);
+        enif_free(pixels);
+        return enif_make_badarg(env);
+    }
+
+    ERL_MAKE_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, instance);
+    if (!instance) {
+        cairo_surface_destroy(data);
+        return enif_make_badarg(env);
+    }
+
+    instance->data = data;
+
+    // Create a garbage-collectable resource
+    ERL_MAKE_GC_RES(instance, surface);
+    return ERL_MAKE_OK_TUPLE(surface);
+}
+
+/**
+ * Wraps cairo_image_surface_create_for_data(unsigned char *data,
+ *   cairo_format_t format,
+ *   int width,
+ *   int height,
+ *   int stride)
+ * -> Moves to a dirty CPU scheduler if the image is large
+ * @brief EX_image_surface_create_for_data
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_image_surface_create_for_data(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(5);
+    ERL_GET_INT(2, width);
+    ERL_GET_INT(3, height);
+
+    ERL_SCHEDULE_DIRTY_IF((long) width * height > DIRTY_AREA_THRESHOLD, "image_surface_create_for_data",
+                          ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_image_surface_create_for_data_dirty);
+
+    return EX_image_surface_create_for_data_dirty(env, argc, argv);
+}
+
+/**
+ * Wraps cairo_create(cairo_surface_t* target)
+ * @brief EX_cairo_create
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_cairo_create (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface)
+    ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
+
+    ERL_MAKE_INSTANCE(cairo_t_TYPE, cairo_t_RT, instance);
+    ERL_ASSERT(instance);
+
+    instance->data = cairo_create(surface->data);
+
+    // The context keeps its target alive and draws under its lock
+    instance->target = surface;
+    enif_keep_resource(surface);
+
+    // Create a garbage-collectable resource
+    ERL_MAKE_GC_RES(instance, context);
+    return ERL_MAKE_OK_TUPLE(context);
+}
+
+/**
+ * Bytes per pixel of an image format
+ * @brief format_bytes_per_pixel
+ * @return the size, 0 for formats with less than a byte per pixel
+ */
+static int format_bytes_per_pixel(cairo_format_t format) {
+    switch (format) {
+    case CAIRO_FORMAT_ARGB32:
+    case CAIRO_FORMAT_RGB24:
+    case CAIRO_FORMAT_RGB30:
+        return 4;
+    case CAIRO_FORMAT_RGB16_565:
+        return 2;
+    case CAIRO_FORMAT_A8:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Encodes one changed tile into *term, copied out of the pixels of the
+ * current frame
+ * @brief encode_tile
+ * @return 1 on success, 0 if encoding failed
+ */
+static int encode_tile(ErlNifEnv *env, cairo_format_t format, const unsigned char *data, int stride,
+                       int bpp, int width, int height, int png, ERL_NIF_TERM *term) {
+    int y;
+
+    if (!png) {
+        unsigned char *out = enif_make_new_binary(env, (size_t) width * bpp * height, term);
+        for (y = 0; y < height; y++) {
+            memcpy(out + (size_t) y * width * bpp, data + (size_t) y * stride, (size_t) width * bpp);
+        }
+        return 1;
+    }
+
+    cairo_surface_t *tile = cairo_image_surface_create(format, width, height);
+    if (cairo_surface_status(tile) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(tile);
+        return 0;
+    }
+
+    cairo_surface_flush(tile);
+    unsigned char *tile_data = cairo_image_surface_get_data(tile);
+    int tile_stride = cairo_image_surface_get_stride(tile);
+    for (y = 0; y < height; y++) {
+        memcpy(tile_data + (size_t) y * tile_stride, data + (size_t) y * stride, (size_t) width * bpp);
+    }
+    cairo_surface_mark_dirty(tile);
+
+    png_buffer_t buffer;
+    cairo_status_t status = png_encode_surface(tile, &buffer);
+    cairo_surface_destroy(tile);
+    if (status != CAIRO_STATUS_SUCCESS) {
+        return 0;
+    }
+
+    *term = enif_make_binary(env, &buffer.bin);
+    return 1;
+}
+
+/**
+ * Compares an image surface with a snapshot of the previous frame in
+ * tiles of argv[2] x argv[2] pixels, see EX_surface_diff_tiles
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_surface_diff_tiles_dirty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_diff_tiles_dirty (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(4);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 1, previous);
+    ERL_ASSERT(surface && previous && surface != previous);
+
+    ERL_GET_INT(2, tile_size);
+    ERL_ASSERT(tile_size > 0);
+
+    int png = 0;
+    ERL_TRY_ATOM(3, ET_png, png, 1)
+    _ERL_TRY_ATOM(3, ET_raw, png, 0)
+    _ERL_FAIL_ATOM;
+
+    ERL_LOCK_INSTANCE(surface);
+    ERL_LOCK_INSTANCE(previous);
+
+    cairo_surface_t *current = surface->data;
+    cairo_surface_t *snapshot = previous->data;
+    ERL_ASSERT(cairo_surface_get_type(current) == CAIRO_SURFACE_TYPE_IMAGE);
+    ERL_ASSERT(cairo_surface_get_type(snapshot) == CAIRO_SURFACE_TYPE_IMAGE);
+
+    cairo_format_t format = cairo_image_surface_get_format(current);
+    int width = cairo_image_surface_get_width(current);
+    int height = cairo_image_surface_get_height(current);
+    int bpp = format_bytes_per_pixel(format);
+    ERL_ASSERT(bpp > 0);
+    ERL_ASSERT(cairo_image_surface_get_format(snapshot) == format &&
+               cairo_image_surface_get_width(snapshot) == width &&
+               cairo_image_surface_get_height(snapshot) == height);
+
+    cairo_surface_flush(current);
+    cairo_surface_flush(snapshot);
+
+    const unsigned char *data = cairo_image_surface_get_data(current);
+    unsigned char *previous_data = cairo_image_surface_get_data(snapshot);
+    int stride = cairo_image_surface_get_stride(current);
+    int previous_stride = cairo_image_surface_get_stride(snapshot);
+    ERL_ASSERT(data && previous_data);
+
+    // The changed tiles, in the order they are found
+    size_t max_changed = (size_t) ((width + tile_size - 1) / tile_size) * ((height + tile_size - 1) / tile_size);
+    cairo_rectangle_int_t *changed = enif_alloc(sizeof(cairo_rectangle_int_t) * (max_changed ? max_changed : 1));
+    if (!changed) {
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_atom(env, "no_memory"));
+    }
+    size_t num_changed = 0;
+
+    // Walk the tiles backwards so the list comes out in row-major order
+    ERL_NIF_TERM tiles = enif_make_list(env, 0);
+    int tile_y, tile_x;
+    for (tile_y = ((height - 1) / tile_size) * tile_size; tile_y >= 0; tile_y -= tile_size) {
+        int tile_height = height - tile_y < tile_size ? height - tile_y : tile_size;
+
+        for (tile_x = ((width - 1) / tile_size) * tile_size; tile_x >= 0; tile_x -= tile_size) {
+            int tile_width = width - tile_x < tile_size ? width - tile_x : tile_size;
+            size_t span = (size_t) tile_width * bpp;
+            const unsigned char *rows = data + (size_t) tile_y * stride + (size_t) tile_x * bpp;
+            const unsigned char *previous_rows = previous_data + (size_t) tile_y * previous_stride + (size_t) tile_x * bpp;
+
+            // memcmp compares whole vectors at a time, one row span per call
+            int y;
+            for (y = 0; y < tile_height; y++) {
+                if (memcmp(rows + (size_t) y * stride, previous_rows + (size_t) y * previous_stride, span) != 0) {
+                    break;
+                }
+            }
+            if (y == tile_height) {
+                continue;
+            }
+
+            ERL_NIF_TERM encoded;
+            if (!encode_tile(env, format, rows, stride, bpp, tile_width, tile_height, png, &encoded)) {
+                enif_free(changed);
+                return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_atom(env, "no_memory"));
+            }
+
+            changed[num_changed].x = tile_x;
+            changed[num_changed].y = tile_y;
+            changed[num_changed].width = tile_width;
+            changed[num_changed].height = tile_height;
+            num_changed++;
+
+            ERL_NIF_TERM tile = enif_make_tuple5(env,
+                                                 enif_make_int(env, tile_x),
+                                                 enif_make_int(env, tile_y),
+                                                 enif_make_int(env, tile_width),
+                                                 enif_make_int(env, tile_height),
+                                                 encoded);
+            tiles = enif_make_list_cell(env, tile, tiles);
+        }
+    }
+
+    // Only once every changed tile is encoded does the snapshot become
+    // the current frame, so a failed call leaves it untouched
+    size_t i;
+    for (i = 0; i < num_changed; i++) {
+        const cairo_rectangle_int_t *tile = &changed[i];
+        int row;
+        for (row = tile->y; row < tile->y + tile->height; row++) {
+            memcpy(previous_data + (size_t) row * previous_stride + (size_t) tile->x * bpp,
+                   data + (size_t) row * stride + (size_t) tile->x * bpp,
+                   (size_t) tile->width * bpp);
+        }
+    }
+
+    if (num_changed > 0) {
+        cairo_surface_mark_dirty(snapshot);
+    }
+
+    enif_free(changed);
+    return ERL_MAKE_OK_TUPLE(tiles);
+}
+
+/**
+ * Compares an image surface with a snapshot of the previous frame and
+ * returns the tiles that changed
+ * -> Returns {:ok, [{x, y, width, height, data}]} in row-major order,
+ * where data is a PNG or the raw rows of the tile in the pixel format
+ * of the surface
+ * -> The snapshot is updated in place to match the surface, so it can
+ * be passed again with the next frame
+ * -> Moves to a dirty CPU scheduler if the surface is large
+ * @brief EX_surface_diff_tiles
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_diff_tiles (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(4);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
+    ERL_ASSERT(surface);
+
+    ERL_SCHEDULE_DIRTY_IF(SURFACE_AREA(surface->data) > DIRTY_AREA_THRESHOLD,
+                          "surface_diff_tiles", ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_surface_diff_tiles_dirty);
+
+    return EX_surface_diff_tiles_dirty(env, argc, argv);
+}
+
+/**
+ * Wraps cairo_surface_mark_dirty_rectangle(cairo_surface_t *surface, int x, int y, int width, int height)
+ * -> Also adds the rectangle to the damage of the surface if damage
+ * is tracked
+ * @brief EX_surface_mark_dirty_rectangle
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_mark_dirty_rectangle (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(5);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
+    ERL_ASSERT(surface);
+
+    cairo_rectangle_int_t rect;
+    ERL_ASSERT(enif_get_int(env, argv[1], &rect.x));
+    ERL_ASSERT(enif_get_int(env, argv[2], &rect.y));
+    ERL_ASSERT(enif_get_int(env, argv[3], &rect.width));
+    ERL_ASSERT(enif_get_int(env, argv[4], &rect.height));
+
+    ERL_LOCK_INSTANCE(surface);
+    cairo_surface_mark_dirty_rectangle(surface->data, rect.x, rect.y, rect.width, rect.height);
+
+    damage_t *damage = (damage_t *) cairo_surface_get_user_data(surface->data, &damage_key);
+    if (damage) {
+        damage_add_rectangle(damage, &rect);
+    }
+
+    return ERL_OK;
+}
+
+/**
+ * Destroys all pooled surfaces. The configured caps are kept.
+ * @brief EX_surface_pool_clear
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_pool_clear (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(0);
+
+    surface_pool_clear();
+    return ERL_OK;
+}
+
+/**
+ * Sets how many collected image surfaces of the given format and size
+ * are kept for reuse by image_surface_create. A cap of 0 disables
+ * pooling for that shape.
+ * @brief EX_surface_pool_set_cap
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_pool_set_cap (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(4);
+
+    cairo_format_t format = -1;
+    ERL_TRY_ATOM(0, ET_argb32,      format, 0)
+    _ERL_TRY_ATOM(0, ET_rgb24,       format, 1)
+    _ERL_TRY_ATOM(0, ET_a8,          format, 2)
+    _ERL_TRY_ATOM(0, ET_a1,          format, 3)
+    _ERL_TRY_ATOM(0, ET_rgb16_565,   format, 4)
+    _ERL_TRY_ATOM(0, ET_rgb30,       format, 5)
+    _ERL_FAIL_ATOM;
+
+    ERL_GET_INT(1, width);
+    ERL_GET_INT(2, height);
+    ERL_GET_INT(3, cap);
+    ERL_ASSERT(width > 0 && height > 0 && cap >= 0);
+
+    ERL_ASSERT(surface_pool_set_cap(format, width, height, cap));
+    return ERL_OK;
+}
+
+/**
+ * Reports the state of every pool bucket as a list of
+ * {format, width, height, cap, pooled, hits, misses}
+ * @brief EX_surface_pool_stats
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_pool_stats (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(0);
+
+    ERL_NIF_TERM list = enif_make_list(env, 0);
+
+    enif_mutex_lock(surface_pool.lock);
+    surface_bucket_t *bucket;
+    for (bucket = surface_pool.buckets; bucket; bucket = bucket->next) {
+        ERL_NIF_TERM format = ET_invalid;
+        switch (bucket->format) {
+        case CAIRO_FORMAT_ARGB32:       format = ET_argb32; break;
+        case CAIRO_FORMAT_RGB24:        format = ET_rgb24; break;
+        case CAIRO_FORMAT_A8:           format = ET_a8; break;
+        case CAIRO_FORMAT_A1:           format = ET_a1; break;
+        case CAIRO_FORMAT_RGB16_565:    format = ET_rgb16_565; break;
+        case CAIRO_FORMAT_RGB30:        format = ET_rgb30; break;
+        default: break;
+        }
+
+        list = enif_make_list_cell(env, enif_make_tuple(env, 7,
+                                       format,
+                                       enif_make_int(env, bucket->width),
+                                       enif_make_int(env, bucket->height),
+                                       enif_make_int(env, bucket->cap),
+                                       enif_make_int(env, bucket->count),
+                                       enif_make_ulong(env, bucket->hits),
+                                       enif_make_ulong(env, bucket->misses)), list);
+    }
+    enif_mutex_unlock(surface_pool.lock);
+
+    return list;
+}
+
+/**
+ * Copies an image surface into a new image surface of the same
+ * format and size, e.g. to keep the previous frame for
+ * surface_diff_tiles
+ * @brief EX_surface_snapshot
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_snapshot (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
+    ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
+
+    cairo_surface_t *source = surface->data;
+    ERL_ASSERT(cairo_surface_get_type(source) == CAIRO_SURFACE_TYPE_IMAGE);
+
+    cairo_format_t format = cairo_image_surface_get_format(source);
+    int width = cairo_image_surface_get_width(source);
+    int height = cairo_image_surface_get_height(source);
+
+    cairo_surface_t *copy = surface_pool_checkout(format, width, height, 0);
+    if (!copy) {
+        copy = cairo_image_surface_create(format, width, height);
+    }
+    if (cairo_surface_status(copy) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(copy);
+        return enif_make_badarg(env);
+    }
+
+    cairo_surface_flush(source);
+    cairo_surface_flush(copy);
+
+    const unsigned char *data = cairo_image_surface_get_data(source);
+    unsigned char *copy_data = cairo_image_surface_get_data(copy);
+    int stride = cairo_image_surface_get_stride(source);
+    int copy_stride = cairo_image_surface_get_stride(copy);
+    size_t span = stride < copy_stride ? (size_t) stride : (size_t) copy_stride;
+
+    int y;
+    for (y = 0; y < height; y++) {
+        memcpy(copy_data + (size_t) y * copy_stride, data + (size_t) y * stride, span);
+    }
+    cairo_surface_mark_dirty(copy);
+
+    ERL_MAKE_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, instance);
+    if (!instance) {
+        cairo_surface_destroy(copy);
+        return enif_make_badarg(env);
+    }
+    instance->data = copy;
+
+    ERL_MAKE_GC_RES(instance, snapshot);
+    return ERL_MAKE_OK_TUPLE(snapshot);
+}
+
+/**
+ * State of a surface_stream_png job. The job holds a reference on the
+ * surface resource and owns its lock until the encode is done.
+ */
+typedef struct {
+    cairo_surface_t_TYPE *surface;
+    png_stream_t stream;
+} png_stream_job_t;
+
+/**
+ * Runs on a pool thread: encodes the surface, sending the PNG in
+ * chunks as it is produced, then sends
+ * {:excairo_png_done, ref, :ok | {:error, status}}
+ * @brief run_png_stream_job
+ * @param arg a png_stream_job_t
+ */
+static void run_png_stream_job(void *arg) {
+    png_stream_job_t *job = (png_stream_job_t *) arg;
+    png_stream_t *stream = &job->stream;
+
+    cairo_status_t status = cairo_surface_write_to_png_stream(job->surface->data, png_stream_write, stream);
+    if (status == CAIRO_STATUS_SUCCESS && !png_stream_flush(stream)) {
+        status = CAIRO_STATUS_WRITE_ERROR;
+    }
+    if (stream->has_chunk) {
+        enif_release_binary(&stream->chunk);
+    }
+
+    // The surface can be used again before the receiver sees the result
+    resource_unlock(&job->surface->lock);
+    enif_release_resource(job->surface);
+
+    ErlNifEnv *env = stream->msg_env;
+    ERL_NIF_TERM result = status == CAIRO_STATUS_SUCCESS
+            ? enif_make_atom(env, "ok")
+            : enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, status));
+
+    enif_send(NULL, &stream->pid, env,
+              enif_make_tuple3(env, enif_make_atom(env, "excairo_png_done"),
+                               enif_make_copy(env, stream->ref), result));
+
+    enif_free_env(stream->msg_env);
+    enif_free_env(stream->ref_env);
+    enif_free(job);
+}
+
+/**
+ * Wraps cairo_surface_write_to_png_stream(cairo_surface_t *surface,
+ *   cairo_write_func_t write_func,
+ *   void *closure)
+ * -> Encodes on a native worker thread and sends the PNG to pid while
+ * it is produced, as {:excairo_png_chunk, ref, chunk} messages of up
+ * to PNG_CHUNK_SIZE bytes followed by
+ * {:excairo_png_done, ref, :ok | {:error, status}}
+ * -> Returns :ok right away, or {:error, :busy} if the surface is in
+ * use. The surface stays locked until the encode is done.
+ * @brief EX_surface_stream_png
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_stream_png (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(3);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
+    ERL_ASSERT(surface);
+
+    ErlNifPid pid;
+    ERL_ASSERT(enif_get_local_pid(env, argv[1], &pid));
+
+    png_stream_job_t *job = enif_alloc(sizeof(png_stream_job_t));
+    ERL_ASSERT(job);
+    memset(job, 0, sizeof(png_stream_job_t));
+
+    // The job owns the lock until the worker has finished
+    if (!resource_trylock(&surface->lock, (unsigned long) job)) {
+        enif_free(job);
+        return ERL_BUSY;
+    }
+
+    job->surface = surface;
+    job->stream.pid = pid;
+    job->stream.ref_env = enif_alloc_env();
+    job->stream.msg_env = enif_alloc_env();
+    job->stream.ref = enif_make_copy(job->stream.ref_env, argv[2]);
+
+    // Keep the surface alive until the job has finished
+    enif_keep_resource(surface);
+
+    if (!pool_submit(run_png_stream_job, job)) {
+        resource_unlock(&surface->lock);
+        enif_release_resource(surface);
+        enif_free_env(job->stream.msg_env);
+        enif_free_env(job->stream.ref_env);
+        enif_free(job);
+        return enif_make_badarg(env);
+    }
+
+    return ERL_OK;
+}
+
+/**
+ * Takes the damage accumulated by a surface since the last call and
+ * starts over with an empty region
+ * -> Returns {:ok, region} in device space, or {:error, :not_tracked}
+ * if damage tracking is disabled for the surface
+ * @brief EX_surface_take_damage
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_take_damage (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
+    ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
+
+    if (!cairo_surface_get_user_data(surface->data, &damage_key)) {
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_atom(env, "not_tracked"));
+    }
 
-    instance->data = cairo_recording_surface_create(content, &rect);
+    cairo_region_t *region = damage_take(surface->data);
+    ERL_ASSERT(region);
 
-    // Create a garbage-collectable resource
-    ERL_MAKE_GC_RES(instance, surface);
-    return ERL_MAKE_OK_TUPLE(surface);
+    return make_region(env, region);
 }
 
 /**
- * Wraps cairo_recording_surface_get_extents(
- *   cairo_surface_t *surface,
- *   cairo_rectangle_t *extents);
- * @brief EX_recording_surface_get_extents
+ * Enables or disables damage tracking for a surface. While enabled,
+ * fill, stroke, paint, mask and text drawing through any context, as
+ * well as surface_mark_dirty_rectangle, add the device space bounds of
+ * what they touch to the damage of the surface. Disabling drops the
+ * accumulated damage.
+ * @brief EX_surface_track_damage
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_recording_surface_get_extents(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+static ERL_NIF_TERM EX_surface_track_damage (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
+    ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
+
+    int enable = enif_compare(argv[1], enif_make_atom(env, "true")) == 0;
+    ERL_ASSERT(enable || enif_compare(argv[1], enif_make_atom(env, "false")) == 0);
+    ERL_ASSERT(damage_enable(surface->data, enable));
+
+    return ERL_OK;
+}
+
+/**
+ * Wraps cairo_surface_write_to_png(cairo_surface_t* surface, const char* filename)
+ * -> The file name argument is expected to be a UTF-8 encoded binary
+ * -> Variant that may run on a dirty IO scheduler
+ * @brief EX_surface_write_to_png_dirty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_write_to_png_dirty (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
+    ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
+
+    // Get the filename from the arguments
+    ERL_GET_UTF8_STRING(1, file_name);
+
+    cairo_status_t result = cairo_surface_write_to_png(surface->data, file_name);
+    return ERL_MAKE_OK_TUPLE(enif_make_int(env, result));
+}
+
+/**
+ * Wraps cairo_surface_write_to_png(cairo_surface_t* surface, const char* filename)
+ * -> Moves to a dirty IO scheduler if the surface is large
+ * @brief EX_surface_write_to_png
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_write_to_png (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
+    ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
+
+    ERL_SCHEDULE_DIRTY_IF(SURFACE_AREA(surface->data) > DIRTY_AREA_THRESHOLD,
+                          "surface_write_to_png", ERL_NIF_DIRTY_JOB_IO_BOUND, EX_surface_write_to_png_dirty);
+
+    return EX_surface_write_to_png_dirty(env, argc, argv);
+}
+
+/**
+ * Wraps cairo_surface_write_to_png_stream(cairo_surface_t *surface,
+ *   cairo_write_func_t write_func,
+ *   void *closure)
+ * -> The image is encoded into a single growing binary
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_surface_write_to_png_binary_dirty
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_surface_write_to_png_binary_dirty (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(1);
-    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface)
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
     ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
 
-    cairo_rectangle_t extents;
-    if (cairo_recording_surface_get_extents(surface->data, &extents)) {
-        return enif_make_tuple4(env,
-                                enif_make_double(env, extents.x),
-                                enif_make_double(env, extents.y),
-                                enif_make_double(env, extents.width),
-                                enif_make_double(env, extents.height));
-    } else {
-        return enif_make_badarg(env);
+    png_buffer_t buffer;
+    cairo_status_t result = png_encode_surface(surface->data, &buffer);
+    if (result != CAIRO_STATUS_SUCCESS) {
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, result));
     }
+
+    return ERL_MAKE_OK_TUPLE(enif_make_binary(env, &buffer.bin));
 }
 
 /**
- * Wraps cairo_recording_surface_ink_extents(
- *      cairo_surface_t *surface,
- *      double *x0,
- *      double *y0,
- *      double *width,
- *      double *height);
- * @brief EX_recording_surface_ink_extents
+ * Wraps cairo_surface_write_to_png_stream(cairo_surface_t *surface,
+ *   cairo_write_func_t write_func,
+ *   void *closure)
+ * -> Moves to a dirty CPU scheduler if the surface is large
+ * @brief EX_surface_write_to_png_binary
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_recording_surface_ink_extents(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+static ERL_NIF_TERM EX_surface_write_to_png_binary (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(1);
-    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface)
+    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
     ERL_ASSERT(surface);
+    ERL_LOCK_INSTANCE(surface);
 
-    double x,y,w,h;
-    cairo_recording_surface_ink_extents(surface->data, &x,&y,&w,&h);
-    return enif_make_tuple4(env,
-                            enif_make_double(env, x),
-                            enif_make_double(env, y),
-                            enif_make_double(env, w),
-                            enif_make_double(env, h));
+    ERL_SCHEDULE_DIRTY_IF(SURFACE_AREA(surface->data) > DIRTY_AREA_THRESHOLD,
+                          "surface_write_to_png_binary", ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_surface_write_to_png_binary_dirty);
+
+    return EX_surface_write_to_png_binary_dirty(env, argc, argv);
 }
 
 /**
- * Wraps cairo_rectangle(
- *      cairo_t *cr,
- *      double x,
- *      double y,
- *      double width,
- *      double height);
- * @brief EX_rectangle
+ * Wraps cairo_scaled_font_create(cairo_font_face_t *font_face,
+ *   const cairo_matrix_t *font_matrix,
+ *   const cairo_matrix_t *ctm,
+ *   const cairo_font_options_t *options)
+ * -> The options argument is optional, default options are used
+ * without it
+ * @brief EX_scaled_font_create
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_rectangle(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-    ERL_ASSERT_ARGC(5);
-    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
-    ERL_ASSERT(context);
+static ERL_NIF_TERM EX_scaled_font_create(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT(argc == 3 || argc == 4);
+    ERL_GET_INSTANCE(cairo_font_face_t_TYPE, cairo_font_face_t_RT, 0, font_face);
+    ERL_ASSERT(font_face);
+
+    ERL_IMPORT_MATRIX(1, font_matrix);
+    ERL_IMPORT_MATRIX(2, ctm);
+
+    cairo_scaled_font_t *data;
+    if (argc == 4) {
+        ERL_GET_INSTANCE(cairo_font_options_t_TYPE, cairo_font_options_t_RT, 3, opts);
+        ERL_ASSERT(opts && opts->data);
+        data = cairo_scaled_font_create(font_face->data, &font_matrix, &ctm, opts->data);
+    } else {
+        cairo_font_options_t *options = cairo_font_options_create();
+        data = cairo_scaled_font_create(font_face->data, &font_matrix, &ctm, options);
+        cairo_font_options_destroy(options);
+    }
 
-    double x,y,w,h;
-    enif_get_double(env, argv[1], &x);
-    enif_get_double(env, argv[2], &y);
-    enif_get_double(env, argv[3], &w);
-    enif_get_double(env, argv[4], &h);
+    if (cairo_scaled_font_status(data) != CAIRO_STATUS_SUCCESS) {
+        cairo_scaled_font_destroy(data);
+        return enif_make_badarg(env);
+    }
 
-    cairo_rectangle(context->data, x, y, w, h);
+    ERL_MAKE_INSTANCE(cairo_scaled_font_t_TYPE, cairo_scaled_font_t_RT, instance);
+    if (!instance) {
+        cairo_scaled_font_destroy(data);
+        return enif_make_badarg(env);
+    }
 
-    return ERL_OK;
+    instance->data = data;
+
+    // Create a garbage-collectable resource
+    ERL_MAKE_GC_RES(instance, font);
+    return ERL_MAKE_OK_TUPLE(font);
 }
 
 /**
- * Wraps cairo_region_contains_point(const cairo_region_t *region,
-                                                         int x,
-                                                         int y);
- * @brief EX_region_contains_point
+ * Wraps cairo_set_scaled_font(cairo_t *cr, const cairo_scaled_font_t *scaled_font)
+ * @brief EX_set_scaled_font
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_region_contains_point(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-    ERL_ASSERT_ARGC(3);
-    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, region);
-    ERL_ASSERT(region);
+static ERL_NIF_TERM EX_set_scaled_font(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
-    ERL_GET_INT(1, x);
-    ERL_GET_INT(2, y);
+    ERL_GET_INSTANCE(cairo_scaled_font_t_TYPE, cairo_scaled_font_t_RT, 1, font);
+    ERL_ASSERT(font);
 
-    cairo_bool_t result = cairo_region_contains_point(region->data, x, y);
-    return ERL_BOOL(result);
+    cairo_set_scaled_font(context->data, font->data);
+    return ERL_OK;
 }
 
 /**
- * Wraps cairo_region_contains_rectangle(
- *  const cairo_region_t *region,
- *  const cairo_rectangle_int_t *rectangle);
- * @brief EX_region_contains_point
+ * Wraps cairo_show_glyphs(cairo_t *cr, const cairo_glyph_t *glyphs, int num_glyphs)
+ * -> The glyphs are a packed binary of
+ * <<index::32, x::float-64, y::float-64>> records
+ * @brief EX_show_glyphs
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_region_contains_rectangle(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+static ERL_NIF_TERM EX_show_glyphs(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(2);
-    ERL_GET_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, 0, region);
-    ERL_ASSERT(region);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
 
-    int arity = 4;
-    const ERL_NIF_TERM *tuple;
-    ERL_ASSERT(enif_get_tuple(env, argv[1], &arity, &tuple));
+    ErlNifBinary bin;
+    ERL_ASSERT(enif_inspect_binary(env, argv[1], &bin));
+    ERL_ASSERT(bin.size % PACKED_GLYPH_SIZE == 0);
 
-    cairo_rectangle_int_t rect;
+    size_t count = bin.size / PACKED_GLYPH_SIZE;
+    ERL_ASSERT(count <= INT_MAX);
 
-    enif_get_int(env, tuple[0], &rect.x);
-    enif_get_int(env, tuple[1], &rect.y);
-    enif_get_int(env, tuple[2], &rect.width);
-    enif_get_int(env, tuple[3], &rect.height);
+    cairo_glyph_t stack_glyphs[STACK_GLYPHS];
+    cairo_glyph_t *glyphs = count <= STACK_GLYPHS ? stack_glyphs : enif_alloc(sizeof(cairo_glyph_t) * count);
+    ERL_ASSERT(glyphs);
 
-    cairo_region_overlap_t result = cairo_region_contains_rectangle(region->data, &rect);
-    switch (result) {
-    case CAIRO_REGION_OVERLAP_IN:
-        return enif_make_atom(env, "in");
-    case CAIRO_REGION_OVERLAP_OUT:
-        return enif_make_atom(env, "out");
-    case CAIRO_REGION_OVERLAP_PART:
-        return enif_make_atom(env, "part");
+    read_packed_glyphs(bin.data, bin.size, glyphs);
+    damage_note_glyphs(context->data, glyphs, (int) count);
+    cairo_show_glyphs(context->data, glyphs, (int) count);
+
+    if (glyphs != stack_glyphs) {
+        enif_free(glyphs);
     }
+
+    return ERL_OK;
 }
 
+// Size of one packed cairo_text_extents_t, six float-64 values
+#define PACKED_EXTENTS_SIZE 48
 
 /**
- * Wraps cairo_image_surface_create(cairo_format_t format, int width, int height)
- * @brief EX_image_surface_create
+ * Measures a list of UTF-8 binaries with the font of a context or
+ * with a scaled font, like cairo_text_extents for each string.
+ * -> Returns a packed binary with six float-64 values per string:
+ * x_bearing, y_bearing, width, height, x_advance, y_advance
+ * -> Returns {:error, {index, status}} for the first string that could
+ * not be shaped, e.g. because it is not valid UTF-8
+ * -> Strings are shaped straight from the binaries, short ones on
+ * the stack
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_text_extents_many_dirty
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_image_surface_create(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-    ERL_ASSERT_ARGC(3);
+static ERL_NIF_TERM EX_text_extents_many_dirty(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_GET_INSTANCE(cairo_scaled_font_t_TYPE, cairo_scaled_font_t_RT, 0, font);
+    ERL_ASSERT(context || font);
 
-    cairo_format_t format = -1;
-    ERL_TRY_ATOM(0, ET_invalid,      format, -1)
-    _ERL_TRY_ATOM(0, ET_argb32,      format, 0)
-    _ERL_TRY_ATOM(0, ET_rgb24,       format, 1)
-    _ERL_TRY_ATOM(0, ET_a8,          format, 2)
-    _ERL_TRY_ATOM(0, ET_a1,          format, 3)
-    _ERL_TRY_ATOM(0, ET_rgb16_565,   format, 4)
-    _ERL_TRY_ATOM(0, ET_rgb30,       format, 5)
-    _ERL_FAIL_ATOM;
+    unsigned length;
+    ERL_ASSERT(enif_get_list_length(env, argv[1], &length));
 
-    ERL_GET_INT(1, width);
-    ERL_GET_INT(2, height);
+    resource_lock_t *context_lock __attribute__((cleanup(release_scoped_lock))) = NULL;
+    cairo_scaled_font_t *scaled_font;
+    if (context) {
+        if (!resource_trylock(&context->lock, LOCK_THREAD_TOKEN)) {
+            return ERL_BUSY;
+        }
+        context_lock = &context->lock;
+        scaled_font = cairo_get_scaled_font(context->data);
+    } else {
+        scaled_font = font->data;
+    }
 
-    ERL_MAKE_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, instance);
-    ERL_ASSERT(instance);
+    ERL_NIF_TERM result;
+    unsigned char *out = enif_make_new_binary(env, (size_t) length * PACKED_EXTENTS_SIZE, &result);
+
+    int index = 0;
+    ERL_NIF_TERM head, tail = argv[1];
+    while (enif_get_list_cell(env, tail, &head, &tail)) {
+        ErlNifBinary text;
+        ERL_ASSERT(enif_inspect_binary(env, head, &text));
+        ERL_ASSERT(text.size <= INT_MAX);
+
+        cairo_glyph_t stack_glyphs[STACK_GLYPHS];
+        cairo_glyph_t *glyphs = stack_glyphs;
+        int count = STACK_GLYPHS;
+
+        cairo_text_extents_t extents;
+        memset(&extents, 0, sizeof(extents));
+
+        // cairo only allocates if the text needs more glyphs than provided
+        cairo_status_t status = cairo_scaled_font_text_to_glyphs(scaled_font, 0, 0, (const char *) text.data, (int) text.size,
+                                                                 &glyphs, &count, NULL, NULL, NULL);
+        if (status == CAIRO_STATUS_SUCCESS) {
+            cairo_scaled_font_glyph_extents(scaled_font, glyphs, count, &extents);
+            status = cairo_scaled_font_status(scaled_font);
+        }
+        if (glyphs != stack_glyphs) {
+            cairo_glyph_free(glyphs);
+        }
 
-    instance->data = cairo_image_surface_create(format, width, height);
+        if (status != CAIRO_STATUS_SUCCESS) {
+            return enif_make_tuple2(env, enif_make_atom(env, "error"),
+                                    enif_make_tuple2(env, enif_make_int(env, index), enif_make_int(env, status)));
+        }
 
-    // Create a garbage-collectable resource
-    ERL_MAKE_GC_RES(instance, surface);
-    return ERL_MAKE_OK_TUPLE(surface);
+        write_double_be(out,      extents.x_bearing);
+        write_double_be(out + 8,  extents.y_bearing);
+        write_double_be(out + 16, extents.width);
+        write_double_be(out + 24, extents.height);
+        write_double_be(out + 32, extents.x_advance);
+        write_double_be(out + 40, extents.y_advance);
+        out += PACKED_EXTENTS_SIZE;
+        index++;
+    }
+
+    return result;
 }
 
 /**
- * Wraps cairo_create(cairo_surface_t* target)
- * @brief EX_cairo_create
+ * Measures a list of UTF-8 binaries, see EX_text_extents_many_dirty
+ * -> Moves to a dirty CPU scheduler for long lists
+ * @brief EX_text_extents_many
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_cairo_create (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-    ERL_ASSERT_ARGC(1);
-    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface)
-    ERL_ASSERT(surface);
+static ERL_NIF_TERM EX_text_extents_many(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(2);
 
-    ERL_MAKE_INSTANCE(cairo_t_TYPE, cairo_t_RT, instance);
-    ERL_ASSERT(instance);
+    unsigned length;
+    ERL_ASSERT(enif_get_list_length(env, argv[1], &length));
 
-    instance->data = cairo_create(surface->data);
+    ERL_SCHEDULE_DIRTY_IF(length > ITEMS_PER_CHUNK, "text_extents_many",
+                          ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_text_extents_many_dirty);
 
-    // Create a garbage-collectable resource
-    ERL_MAKE_GC_RES(instance, context);
-    return ERL_MAKE_OK_TUPLE(context);
+    return EX_text_extents_many_dirty(env, argc, argv);
 }
 
 /**
- * Wraps cairo_surface_write_to_png(cairo_surface_t* surface, const char* filename)
- * -> The file name argument is expected to be a UTF-8 encoded binary
- * @brief EX_surface_write_to_png
+ * Wraps cairo_scaled_font_text_to_glyphs(cairo_scaled_font_t *scaled_font,
+ *   double x,
+ *   double y,
+ *   const char *utf8,
+ *   int utf8_len,
+ *   cairo_glyph_t **glyphs,
+ *   int *num_glyphs,
+ *   ...)
+ * -> Returns the glyphs as a packed binary of
+ * <<index::32, x::float-64, y::float-64>> records. Clusters are not
+ * computed.
+ * @brief EX_text_to_glyphs
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_surface_write_to_png (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-    ERL_ASSERT_ARGC(2);
-    ERL_GET_INSTANCE(cairo_surface_t_TYPE, cairo_surface_t_RT, 0, surface);
-    ERL_ASSERT(surface);
+static ERL_NIF_TERM EX_text_to_glyphs(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(4);
+    ERL_GET_INSTANCE(cairo_scaled_font_t_TYPE, cairo_scaled_font_t_RT, 0, font);
+    ERL_ASSERT(font);
 
-    // Get the filename from the arguments
-    ERL_GET_UTF8_STRING(1, file_name);
+    double x, y;
+    ERL_ASSERT(get_number(env, argv[1], &x));
+    ERL_ASSERT(get_number(env, argv[2], &y));
+
+    ErlNifBinary text;
+    ERL_ASSERT(enif_inspect_binary(env, argv[3], &text));
+    ERL_ASSERT(text.size <= INT_MAX);
+
+    cairo_glyph_t *glyphs = NULL;
+    int count = 0;
+    cairo_status_t status = cairo_scaled_font_text_to_glyphs(font->data, x, y,
+                                                             (const char *) text.data, (int) text.size,
+                                                             &glyphs, &count, NULL, NULL, NULL);
+    if (status != CAIRO_STATUS_SUCCESS) {
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, status));
+    }
 
-    cairo_status_t result = cairo_surface_write_to_png(surface->data, file_name);
-    return ERL_MAKE_OK_TUPLE(enif_make_int(env, result));
+    ERL_NIF_TERM packed = make_packed_glyphs(env, glyphs, count);
+    cairo_glyph_free(glyphs);
+
+    return ERL_MAKE_OK_TUPLE(packed);
 }
 
 /**
@@ -2400,6 +5764,7 @@ static ERL_NIF_TERM EX_select_font_face(ErlNifEnv* env, int argc, const ERL_NIF_
     ERL_ASSERT_ARGC(4);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     ERL_GET_UTF8_STRING(1, family);
 
@@ -2431,6 +5796,7 @@ static ERL_NIF_TERM EX_set_font_size(ErlNifEnv* env, int argc, const ERL_NIF_TER
     ERL_ASSERT_ARGC(2);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double font_size;
     enif_get_double(env, argv[1], &font_size);
@@ -2451,6 +5817,7 @@ static ERL_NIF_TERM EX_set_source_rgb(ErlNifEnv* env, int argc, const ERL_NIF_TE
     ERL_ASSERT_ARGC(4);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double red, green, blue;
     enif_get_double(env, argv[1], &red);
@@ -2473,6 +5840,7 @@ static ERL_NIF_TERM EX_move_to(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv
     ERL_ASSERT_ARGC(3);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double x, y;
     enif_get_double(env, argv[1], &x);
@@ -2482,9 +5850,63 @@ static ERL_NIF_TERM EX_move_to(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv
     return ERL_OK;
 }
 
+/**
+ * Does what cairo_show_text does, for text given with its length
+ * instead of a terminating NUL, so it can be read straight from a
+ * binary: shape with the current scaled font at the current point,
+ * show the glyphs (with clusters if the target keeps text) and move
+ * the current point past the last glyph.
+ * @brief show_text_with_length
+ * @return the status of shaping the text or of the context afterwards
+ */
+static cairo_status_t show_text_with_length(cairo_t *cr, const char *utf8, int length) {
+    if (length == 0) {
+        return cairo_status(cr);
+    }
+
+    double x, y;
+    cairo_get_current_point(cr, &x, &y);
+
+    cairo_glyph_t *glyphs = NULL;
+    cairo_text_cluster_t *clusters = NULL;
+    int num_glyphs = 0, num_clusters = 0;
+    cairo_text_cluster_flags_t flags = 0;
+    int with_clusters = cairo_surface_has_show_text_glyphs(cairo_get_target(cr));
+
+    cairo_status_t status = cairo_scaled_font_text_to_glyphs(
+                cairo_get_scaled_font(cr), x, y, utf8, length,
+                &glyphs, &num_glyphs,
+                with_clusters ? &clusters : NULL,
+                with_clusters ? &num_clusters : NULL,
+                with_clusters ? &flags : NULL);
+
+    if (status == CAIRO_STATUS_SUCCESS && num_glyphs > 0) {
+        damage_note_glyphs(cr, glyphs, num_glyphs);
+        if (with_clusters) {
+            cairo_show_text_glyphs(cr, utf8, length, glyphs, num_glyphs, clusters, num_clusters, flags);
+        } else {
+            cairo_show_glyphs(cr, glyphs, num_glyphs);
+        }
+
+        cairo_text_extents_t extents;
+        cairo_glyph_extents(cr, &glyphs[num_glyphs - 1], 1, &extents);
+        cairo_move_to(cr,
+                      glyphs[num_glyphs - 1].x + extents.x_advance,
+                      glyphs[num_glyphs - 1].y + extents.y_advance);
+    }
+
+    cairo_glyph_free(glyphs);
+    cairo_text_cluster_free(clusters);
+
+    return status == CAIRO_STATUS_SUCCESS ? cairo_status(cr) : status;
+}
+
 /**
  * Wraps cairo_show_text(cairo_t *cr, const char *utf8)
  * -> The text to be shown is expected to be a UTF-8 encoded binary
+ * -> Text larger than a scratch buffer is shown straight from the
+ * binary instead of being copied
+ * -> Returns :ok, or {:error, status} if the text could not be shown
  * @brief EX_show_text
  * @param env
  * @param argc
@@ -2495,12 +5917,28 @@ static ERL_NIF_TERM EX_show_text(ErlNifEnv* env, int argc, const ERL_NIF_TERM ar
     ERL_ASSERT_ARGC(2);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
 
-    ERL_GET_UTF8_STRING(1, text);
+    ErlNifBinary bin;
+    ERL_ASSERT(enif_inspect_binary(env, argv[1], &bin));
+
+    cairo_status_t status;
+    if (bin.size > SCRATCH_RETAINED_SIZE) {
+        ERL_ASSERT(bin.size <= INT_MAX);
+        status = show_text_with_length(context->data, (const char *) bin.data, (int) bin.size);
+    } else {
+        ERL_GET_UTF8_STRING(1, text);
 
-    // text now contains UTF-8 Data + terminator char
-    cairo_show_text(context->data, text);
+        // text now contains UTF-8 Data + terminator char
+        damage_note_text(context->data, text);
+        cairo_show_text(context->data, text);
+        status = cairo_status(context->data);
+    }
 
+    if (status != CAIRO_STATUS_SUCCESS) {
+        return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_int(env, status));
+    }
     return ERL_OK;
 }
 
@@ -2516,6 +5954,7 @@ static ERL_NIF_TERM EX_line_to (ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
     ERL_ASSERT_ARGC(3);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
 
     double x, y;
     enif_get_double(env, argv[1], &x);
@@ -2527,25 +5966,53 @@ static ERL_NIF_TERM EX_line_to (ErlNifEnv* env, int argc, const ERL_NIF_TERM arg
 
 /**
  * Wraps cairo_stroke(cairo_t *cr)
- * @brief EX_stroke
+ * -> Variant that may run on a dirty CPU scheduler
+ * @brief EX_stroke_dirty
  * @param env
  * @param argc
  * @param argv
  * @return
  */
-static ERL_NIF_TERM EX_stroke (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+static ERL_NIF_TERM EX_stroke_dirty (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
     ERL_ASSERT_ARGC(1);
     ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
     ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+    ERL_LOCK_TARGET(context);
+    damage_note_stroke(context->data);
     cairo_stroke(context->data);
     return ERL_OK;
 }
 
+/**
+ * Wraps cairo_stroke(cairo_t *cr)
+ * -> Moves to a dirty CPU scheduler if the target surface is large
+ * @brief EX_stroke
+ * @param env
+ * @param argc
+ * @param argv
+ * @return
+ */
+static ERL_NIF_TERM EX_stroke (ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+    ERL_ASSERT_ARGC(1);
+    ERL_GET_INSTANCE(cairo_t_TYPE, cairo_t_RT, 0, context);
+    ERL_ASSERT(context);
+    ERL_LOCK_INSTANCE(context);
+
+    ERL_SCHEDULE_DIRTY_IF(SURFACE_AREA(cairo_get_group_target(context->data)) > DIRTY_AREA_THRESHOLD,
+                          "stroke", ERL_NIF_DIRTY_JOB_CPU_BOUND, EX_stroke_dirty);
+
+    return EX_stroke_dirty(env, argc, argv);
+}
+
 // ///////////////
 // Erlang init
 // ///////////////
 
 static ErlNifFunc nif_funcs[] = {
+    { "append_path",                2, EX_append_path },
+    { "append_path",                3, EX_append_path },
+    { "append_path_binary",         2, EX_append_path_binary },
     { "arc",                        6, EX_arc },
     { "arc_negative",               6, EX_arc_negative },
     { "clip",                       1, EX_clip },
@@ -2558,6 +6025,10 @@ static ErlNifFunc nif_funcs[] = {
     { "copy_path",                  1, EX_copy_path },
     { "copy_path_flat",             1, EX_copy_path_flat },
     { "curve_to",                   7, EX_curve_to },
+    { "display_list_compile",       1, EX_display_list_compile },
+    { "display_list_replay",        2, EX_display_list_replay },
+    { "display_list_replay",        3, EX_display_list_replay },
+    { "execute",                    2, EX_execute },
     { "fill",                       1, EX_fill },
     { "fill_extents",               1, EX_fill_extents },
     { "fill_preserve",              1, EX_fill_preserve },
@@ -2567,16 +6038,86 @@ static ErlNifFunc nif_funcs[] = {
     { "get_dash",                   1, EX_get_dash },
     { "get_dash_count",             1, EX_get_dash_count },
     { "get_fill_rule",              1, EX_get_fill_rule },
+    { "get_scaled_font",            1, EX_get_scaled_font },
+    { "image_surface_create_from_png", 1, EX_image_surface_create_from_png },
+    { "image_surface_create_from_png_binary", 1, EX_image_surface_create_from_png_binary },
+    { "image_surface_get_data",     1, EX_image_surface_get_data },
+    { "in_clip",                    3, EX_in_clip },
+    { "in_clip_many",               2, EX_in_clip_many },
+    { "in_fill",                    3, EX_in_fill },
+    { "in_fill_many",               2, EX_in_fill_many },
+    { "in_stroke",                  3, EX_in_stroke },
+    { "in_stroke_many",             2, EX_in_stroke_many },
+    { "mask_surface",               4, EX_mask_surface },
+    { "matrix_init",                6, EX_matrix_init },
+    { "matrix_init_identity",       0, EX_matrix_init_identity },
+    { "matrix_init_rotate",         1, EX_matrix_init_rotate },
+    { "matrix_init_scale",          2, EX_matrix_init_scale },
+    { "matrix_init_translate",      2, EX_matrix_init_translate },
+    { "matrix_invert",              1, EX_matrix_invert },
+    { "matrix_multiply",            2, EX_matrix_multiply },
+    { "matrix_rotate",              2, EX_matrix_rotate },
+    { "matrix_scale",               3, EX_matrix_scale },
+    { "matrix_to_tuple",            1, EX_matrix_to_tuple },
+    { "matrix_transform_distance",  3, EX_matrix_transform_distance },
+    { "matrix_transform_point",     3, EX_matrix_transform_point },
+    { "matrix_transform_points",    2, EX_matrix_transform_points },
+    { "matrix_translate",           3, EX_matrix_translate },
+    { "paint",                      1, EX_paint },
+    { "path_to_binary",             1, EX_path_to_binary },
+    { "polygon",                    2, EX_polygon },
+    { "polyline",                   2, EX_polyline },
 
     { "image_surface_create",       3, EX_image_surface_create },
+    { "image_surface_create_for_data", 5, EX_image_surface_create_for_data },
     { "create",                     1, EX_cairo_create },
+    { "surface_diff_tiles",         4, EX_surface_diff_tiles },
+    { "surface_mark_dirty_rectangle", 5, EX_surface_mark_dirty_rectangle },
+    { "surface_pool_clear",         0, EX_surface_pool_clear },
+    { "surface_pool_set_cap",       4, EX_surface_pool_set_cap },
+    { "surface_pool_stats",         0, EX_surface_pool_stats },
+    { "surface_snapshot",           1, EX_surface_snapshot },
+    { "surface_stream_png",         3, EX_surface_stream_png },
+    { "surface_take_damage",        1, EX_surface_take_damage },
+    { "surface_track_damage",       2, EX_surface_track_damage },
     { "surface_write_to_png",       2, EX_surface_write_to_png },
+    { "surface_write_to_png_binary", 1, EX_surface_write_to_png_binary },
+    { "scaled_font_create",         3, EX_scaled_font_create },
+    { "scaled_font_create",         4, EX_scaled_font_create },
     { "select_font_face",           4, EX_select_font_face },
+    { "set_scaled_font",            2, EX_set_scaled_font },
     { "set_font_size",              2, EX_set_font_size },
     { "set_source_rgb",             4, EX_set_source_rgb },
     { "move_to",                    3, EX_move_to },
+    { "raster_cache_clear",         0, EX_raster_cache_clear },
+    { "raster_cache_configure",     1, EX_raster_cache_configure },
+    { "raster_cache_render",        5, EX_raster_cache_render },
+    { "raster_cache_stats",         0, EX_raster_cache_stats },
+    { "recording_surface_create",   2, EX_recording_surface_create },
+    { "recording_surface_render_tiles", 4, EX_recording_surface_render_tiles },
+    { "recording_surface_render_tiles", 5, EX_recording_surface_render_tiles },
+    { "render_async",               3, EX_render_async },
+    { "render_bands",               4, EX_render_bands },
+    { "region_contains_point",      3, EX_region_contains_point },
+    { "region_contains_rectangle",  2, EX_region_contains_rectangle },
+    { "region_copy",                1, EX_region_copy },
+    { "region_create",              0, EX_region_create },
+    { "region_create_rectangles",   1, EX_region_create_rectangles },
+    { "region_equal",               2, EX_region_equal },
+    { "region_get_extents",         1, EX_region_get_extents },
+    { "region_get_rectangles",      1, EX_region_get_rectangles },
+    { "region_intersect",           2, EX_region_intersect },
+    { "region_is_empty",            1, EX_region_is_empty },
+    { "region_num_rectangles",      1, EX_region_num_rectangles },
+    { "region_subtract",            2, EX_region_subtract },
+    { "region_translate",           3, EX_region_translate },
+    { "region_union",               2, EX_region_union },
+    { "region_xor",                 2, EX_region_xor },
     { "line_to",                    3, EX_line_to },
+    { "show_glyphs",                2, EX_show_glyphs },
     { "show_text",                  2, EX_show_text },
+    { "text_extents_many",          2, EX_text_extents_many },
+    { "text_to_glyphs",             4, EX_text_to_glyphs },
     { "stroke",                     1, EX_stroke }
 };
 
@@ -2586,5 +6127,5 @@ ERL_NIF_INIT(
     load,
     NULL,
     NULL,
-    NULL
+    unload
 )
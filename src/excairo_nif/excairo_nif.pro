@@ -15,5 +15,11 @@ include(deployment.pri)
 qtcAddDeployment()
 
 HEADERS += \
-    include/excairo_nif.h
+    include/excairo_nif.h \
+    include/excairo_damage.h \
+    include/excairo_ops.h \
+    include/excairo_surface_pool.h \
+    include/excairo_raster_cache.h \
+    include/excairo_pool.h \
+    include/excairo_png.h
 
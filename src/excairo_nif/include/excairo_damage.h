@@ -0,0 +1,231 @@
+#ifndef EXCAIRO_DAMAGE_H
+#define EXCAIRO_DAMAGE_H
+
+// Damage tracking
+// --------------------------------------------------------------------------------
+
+/**
+ * User data key under which a surface with damage tracking enabled
+ * stores its damage_t. Every context drawing to the surface adds to
+ * the same region.
+ */
+static cairo_user_data_key_t damage_key;
+
+/**
+ * The area of a surface drawn to since the damage was last taken, in
+ * device space. The tracker is only ever looked up, changed, replaced
+ * or dropped while the lock of the surface resource is held: drawing
+ * NIFs lock the target of their context (see ERL_LOCK_TARGET), and
+ * the surface NIFs lock the surface itself. That lock keeps a tracker
+ * alive for as long as a context is adding to it.
+ */
+typedef struct {
+    cairo_region_t *region;
+} damage_t;
+
+/**
+ * Destroy function of the damage user data
+ * @brief damage_destroy
+ */
+static void damage_destroy(void *data) {
+    damage_t *damage = (damage_t *) data;
+    cairo_region_destroy(damage->region);
+    enif_free(damage);
+}
+
+/**
+ * Enable or disable damage tracking of a surface. Enabling it on a
+ * surface that already tracks damage keeps the accumulated region.
+ * @brief damage_enable
+ * @return 1 on success, 0 if memory ran out
+ */
+static int damage_enable(cairo_surface_t *surface, int enable) {
+    if (!enable) {
+        cairo_surface_set_user_data(surface, &damage_key, NULL, NULL);
+        return 1;
+    }
+
+    if (cairo_surface_get_user_data(surface, &damage_key)) {
+        return 1;
+    }
+
+    damage_t *damage = enif_alloc(sizeof(damage_t));
+    if (!damage) {
+        return 0;
+    }
+
+    damage->region = cairo_region_create();
+    if (cairo_region_status(damage->region) != CAIRO_STATUS_SUCCESS ||
+        cairo_surface_set_user_data(surface, &damage_key, damage, damage_destroy) != CAIRO_STATUS_SUCCESS) {
+        cairo_region_destroy(damage->region);
+        enif_free(damage);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Get the damage tracker of the surface a context currently draws to
+ * @brief damage_of
+ * @return the tracker or NULL if tracking is disabled
+ */
+static inline damage_t *damage_of(cairo_t *cr) {
+    return (damage_t *) cairo_surface_get_user_data(cairo_get_group_target(cr), &damage_key);
+}
+
+/**
+ * Add a device space rectangle to the damage region
+ * @brief damage_add_rectangle
+ */
+static void damage_add_rectangle(damage_t *damage, const cairo_rectangle_int_t *rect) {
+    if (rect->width <= 0 || rect->height <= 0) {
+        return;
+    }
+
+    cairo_region_union_rectangle(damage->region, rect);
+}
+
+/**
+ * Add the device space bounding box of a user space box of a context,
+ * clipped to the current clip, to the damage region. The box is
+ * widened by pad device pixels on each side.
+ * @brief damage_add_user_box
+ */
+static void damage_add_user_box(damage_t *damage, cairo_t *cr,
+                                double x1, double y1, double x2, double y2, int pad) {
+    double cx1, cy1, cx2, cy2;
+    cairo_clip_extents(cr, &cx1, &cy1, &cx2, &cy2);
+    if (cx1 > x1) x1 = cx1;
+    if (cy1 > y1) y1 = cy1;
+    if (cx2 < x2) x2 = cx2;
+    if (cy2 < y2) y2 = cy2;
+    if (x1 >= x2 || y1 >= y2) {
+        return;
+    }
+
+    double xs[4] = { x1, x2, x1, x2 };
+    double ys[4] = { y1, y1, y2, y2 };
+    double min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    int i;
+    for (i = 0; i < 4; i++) {
+        cairo_user_to_device(cr, &xs[i], &ys[i]);
+        if (i == 0 || xs[i] < min_x) min_x = xs[i];
+        if (i == 0 || ys[i] < min_y) min_y = ys[i];
+        if (i == 0 || xs[i] > max_x) max_x = xs[i];
+        if (i == 0 || ys[i] > max_y) max_y = ys[i];
+    }
+
+    // Round outwards, so partially covered pixels are included
+    cairo_rectangle_int_t rect;
+    rect.x = (int) floor(min_x) - pad;
+    rect.y = (int) floor(min_y) - pad;
+    rect.width = (int) ceil(max_x) + pad - rect.x;
+    rect.height = (int) ceil(max_y) + pad - rect.y;
+
+    damage_add_rectangle(damage, &rect);
+}
+
+/**
+ * Record the damage of the next cairo_fill of a context. Must be
+ * called before the fill, while the path is still set.
+ * @brief damage_note_fill
+ */
+static void damage_note_fill(cairo_t *cr) {
+    damage_t *damage = damage_of(cr);
+    if (damage) {
+        double x1, y1, x2, y2;
+        cairo_fill_extents(cr, &x1, &y1, &x2, &y2);
+        damage_add_user_box(damage, cr, x1, y1, x2, y2, 0);
+    }
+}
+
+/**
+ * Record the damage of the next cairo_stroke of a context. Must be
+ * called before the stroke, while the path is still set.
+ * @brief damage_note_stroke
+ */
+static void damage_note_stroke(cairo_t *cr) {
+    damage_t *damage = damage_of(cr);
+    if (damage) {
+        double x1, y1, x2, y2;
+        cairo_stroke_extents(cr, &x1, &y1, &x2, &y2);
+        damage_add_user_box(damage, cr, x1, y1, x2, y2, 0);
+    }
+}
+
+/**
+ * Record the damage of painting or masking, which may touch the whole
+ * clip
+ * @brief damage_note_paint
+ */
+static void damage_note_paint(cairo_t *cr) {
+    damage_t *damage = damage_of(cr);
+    if (damage) {
+        double x1, y1, x2, y2;
+        cairo_clip_extents(cr, &x1, &y1, &x2, &y2);
+        damage_add_user_box(damage, cr, x1, y1, x2, y2, 0);
+    }
+}
+
+/**
+ * Record the damage of showing glyphs. Ink extents don't account for
+ * hinting and antialiasing, so the box is widened by a pixel.
+ * @brief damage_note_glyphs
+ */
+static void damage_note_glyphs(cairo_t *cr, const cairo_glyph_t *glyphs, int count) {
+    damage_t *damage = damage_of(cr);
+    if (damage && count > 0) {
+        cairo_text_extents_t extents;
+        cairo_glyph_extents(cr, glyphs, count, &extents);
+        damage_add_user_box(damage, cr, extents.x_bearing, extents.y_bearing,
+                            extents.x_bearing + extents.width, extents.y_bearing + extents.height, 1);
+    }
+}
+
+/**
+ * Record the damage of showing text at the current point, see
+ * damage_note_glyphs
+ * @brief damage_note_text
+ */
+static void damage_note_text(cairo_t *cr, const char *utf8) {
+    damage_t *damage = damage_of(cr);
+    if (damage) {
+        double x = 0, y = 0;
+        if (cairo_has_current_point(cr)) {
+            cairo_get_current_point(cr, &x, &y);
+        }
+
+        cairo_text_extents_t extents;
+        cairo_text_extents(cr, utf8, &extents);
+        damage_add_user_box(damage, cr, x + extents.x_bearing, y + extents.y_bearing,
+                            x + extents.x_bearing + extents.width, y + extents.y_bearing + extents.height, 1);
+    }
+}
+
+/**
+ * Take the accumulated damage of a surface, leaving an empty region
+ * @brief damage_take
+ * @return the region or NULL if tracking is disabled or memory ran out
+ */
+static cairo_region_t *damage_take(cairo_surface_t *surface) {
+    damage_t *damage = (damage_t *) cairo_surface_get_user_data(surface, &damage_key);
+    if (!damage) {
+        return NULL;
+    }
+
+    cairo_region_t *empty = cairo_region_create();
+    if (cairo_region_status(empty) != CAIRO_STATUS_SUCCESS) {
+        cairo_region_destroy(empty);
+        return NULL;
+    }
+
+    cairo_region_t *taken = damage->region;
+    damage->region = empty;
+
+    return taken;
+}
+
+// --------------------------------------------------------------------------------
+
+#endif // EXCAIRO_DAMAGE_H
@@ -1,5 +1,10 @@
+#ifndef EXCAIRO_NIF_H
+#define EXCAIRO_NIF_H
+
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
 #include <assert.h>
 
 #include "erl_nif.h"
@@ -18,7 +23,8 @@
 // Create a new instance given an erlang resource type
 #define ERL_MAKE_INSTANCE(type, rt, name) \
     type *instance; \
-    name = enif_alloc_resource(rt, sizeof(type));
+    name = enif_alloc_resource(rt, sizeof(type)); \
+    if (name) memset(name, 0, sizeof(type));
 
 // Get a pointer to a resource type from an argument
 #define ERL_GET_INSTANCE(type, rt, pos, name) \
@@ -30,12 +36,10 @@
     ERL_NIF_TERM name = enif_make_resource(env, object); \
     enif_release_resource(object);
 
+// Get a NUL terminated string from a binary argument, see scratch_string
 #define ERL_GET_UTF8_STRING(pos, name) \
-    ErlNifBinary bin; \
-    enif_inspect_binary(env, argv[pos], &bin); \
-    char name[bin.size + 1]; \
-    memset(name, 0, bin.size + 1); \
-    memcpy(name, bin.data, bin.size);
+    const char *name = scratch_string(env, argv[pos], pos); \
+    ERL_ASSERT(name);
 
 #define ERL_TRY_ATOM(pos, atom, name, value) \
     if (enif_compare(argv[pos], atom) == 0) { name = value; }
@@ -48,6 +52,7 @@
 // Standard return type
 #define ERL_MAKE_OK_TUPLE(data) enif_make_tuple2(env, enif_make_atom(env, "ok"), data)
 #define ERL_OK enif_make_atom(env, "ok");
+#define ERL_BUSY enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_atom(env, "busy"))
 
 #define ERL_BOOL(cairo_bool) \
     cairo_bool ? enif_make_atom(env, "true") : enif_make_atom(env, "false")
@@ -55,6 +60,25 @@
 // Use only in nif initializer function
 #define ERL_ASSERT_LOAD(condition) if (!(condition)) return -1
 
+// Surfaces with more pixels than this are rasterized / encoded on a
+// dirty scheduler instead of blocking a normal one
+#define DIRTY_AREA_THRESHOLD (512 * 512)
+
+// Number of pixels of an image surface, 0 for all other surface types
+#define SURFACE_AREA(surface) \
+    (cairo_surface_get_type(surface) == CAIRO_SURFACE_TYPE_IMAGE ? \
+        (long) cairo_image_surface_get_width(surface) * cairo_image_surface_get_height(surface) : 0)
+
+// Long running calls work through their input in chunks of this many
+// items and report TIMESLICE_PERCENT of a timeslice per chunk. Once the
+// timeslice is used up they yield with enif_schedule_nif.
+#define ITEMS_PER_CHUNK 4096
+#define TIMESLICE_PERCENT 10
+
+// Continue the current call in fptr on a dirty scheduler if condition holds
+#define ERL_SCHEDULE_DIRTY_IF(condition, name, flags, fptr) \
+    if (condition) return enif_schedule_nif(env, name, flags, fptr, argc, argv)
+
 // Export a standard matrix with the format
 //  --------
 // | xx | yx |
@@ -68,26 +92,14 @@
     enif_make_tuple2(env, enif_make_double(env, name.xy), enif_make_double(env, name.yy)), \
     enif_make_tuple2(env, enif_make_double(env, name.x0), enif_make_double(env, name.y0)));
 
+// Import a matrix resource or a matrix in the format above,
+// see import_matrix
 #define ERL_IMPORT_MATRIX(pos, name) \
-    int name ## _arity = 3; \
-    const ERL_NIF_TERM *name ## _tuple; \
-    ERL_ASSERT(enif_get_tuple(env, argv[pos], &name ## _arity, &name ## _tuple)); \
-    name ## _arity = 2; \
-    const ERL_NIF_TERM *name ## _row_1; \
-    const ERL_NIF_TERM *name ## _row_2; \
-    const ERL_NIF_TERM *name ## _row_3; \
-    ERL_ASSERT(enif_get_tuple(env, name ## _tuple[0], &name ## _arity, &name ## _row_1)); \
-    ERL_ASSERT(enif_get_tuple(env, name ## _tuple[0], &name ## _arity, &name ## _row_2)); \
-    ERL_ASSERT(enif_get_tuple(env, name ## _tuple[0], &name ## _arity, &name ## _row_3)); \
     cairo_matrix_t name; \
-    enif_get_double(env, name ## _row_1[0], &name.xx); \
-    enif_get_double(env, name ## _row_1[1], &name.yx); \
-    enif_get_double(env, name ## _row_2[0], &name.xy); \
-    enif_get_double(env, name ## _row_2[1], &name.yy); \
-    enif_get_double(env, name ## _row_3[0], &name.x0); \
-    enif_get_double(env, name ## _row_3[1], &name.y0);
-
-
+    switch (import_matrix(env, argv[pos], &name)) { \
+    case 0: return enif_make_badarg(env); \
+    case -1: return ERL_BUSY; \
+    }
 
 // --------------------------------------------------------------------------------
 
@@ -168,39 +180,225 @@ static ERL_NIF_TERM ET_color;
 static ERL_NIF_TERM ET_alpha;
 static ERL_NIF_TERM ET_color_alpha;
 
+// Tile encodings
+static ERL_NIF_TERM ET_png;
+static ERL_NIF_TERM ET_raw;
+
 // --------------------------------------------------------------------------------
 
+#include "excairo_damage.h"
+#include "excairo_ops.h"
+#include "excairo_surface_pool.h"
+#include "excairo_raster_cache.h"
 
-// cairo_t
+
+// Resource locking
 // --------------------------------------------------------------------------------
 
 /**
- * Erlang Resource Type representing a
- * cairo_t
- * @brief cairo_t_RT
+ * Non-blocking ownership flag embedded in resources that wrap mutable
+ * cairo objects. A caller either becomes the owner right away or
+ * fails; it never waits. The owner may take the lock again (nested
+ * NIF calls), it is released when the outermost owner unlocks.
  */
-static ErlNifResourceType *cairo_t_RT = NULL;
+typedef struct {
+    volatile unsigned long owner;
+    int depth;
+} resource_lock_t;
+
+// The address of a thread local variable identifies the calling thread
+static __thread char lock_thread_marker;
+#define LOCK_THREAD_TOKEN ((unsigned long) &lock_thread_marker)
 
 /**
- * Struct to use in place of cairo_surface_t when
- * allocating resources with enif_alloc_resource
+ * Try to take the lock on behalf of token
+ * @brief resource_trylock
+ * @return 1 if the lock is now held by token, 0 if someone else holds it
+ */
+static int resource_trylock(resource_lock_t *lock, unsigned long token) {
+    if (lock->owner == token) {
+        lock->depth++;
+        return 1;
+    }
+
+    if (__sync_bool_compare_and_swap(&lock->owner, 0, token)) {
+        lock->depth = 1;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Give up one level of ownership
+ * @brief resource_unlock
+ */
+static void resource_unlock(resource_lock_t *lock) {
+    if (--lock->depth == 0) {
+        __sync_lock_release(&lock->owner);
+    }
+}
+
+/**
+ * Cleanup handler used by ERL_LOCK_INSTANCE
+ * @brief release_scoped_lock
+ */
+static void release_scoped_lock(resource_lock_t **lock) {
+    if (*lock) {
+        resource_unlock(*lock);
+    }
+}
+
+// Take the lock of an instance for the rest of the enclosing scope.
+// Returns {:error, :busy} from the NIF if another caller holds it.
+#define ERL_LOCK_INSTANCE(name) \
+    resource_lock_t *name ## _lock __attribute__((cleanup(release_scoped_lock))) = NULL; \
+    if (!resource_trylock(&name->lock, LOCK_THREAD_TOKEN)) return ERL_BUSY; \
+    name ## _lock = &name->lock;
+
+// --------------------------------------------------------------------------------
+
+
+// Scratch arena
+// --------------------------------------------------------------------------------
+
+// Number of argument positions with their own scratch buffer
+#define SCRATCH_SLOTS 4
+
+// Scratch buffers larger than this are given back once a smaller
+// string comes along, so one huge argument isn't kept forever
+#define SCRATCH_RETAINED_SIZE (64 * 1024)
+
+/**
+ * Buffer for NUL terminated copies of binary arguments at one
+ * argument position
  */
 typedef struct {
-    cairo_t *data;
-} cairo_t_TYPE;
+    char *data;
+    size_t capacity;
+} scratch_slot_t;
 
 /**
- * Destructor function to enable garbage collection of
- * cairo_surface_t instances
- * @brief gc_cairo_surface_t
- * @param env Erlang environment
- * @param instance wraps a cairo_surface_t instance
+ * The scratch slots of one thread. Every scheduler (normal or dirty)
+ * is a thread of its own, so the slots are never shared. Arenas are
+ * linked into a global list only so unload can free them.
  */
-static void gc_cairo_t (ErlNifEnv *env, void *instance) {
-    cairo_t_TYPE* context = (cairo_t_TYPE *) instance;
-    if (env && context && context->data) {
-        cairo_destroy(context->data);
+typedef struct scratch_arena {
+    scratch_slot_t slots[SCRATCH_SLOTS];
+    struct scratch_arena *next;
+} scratch_arena_t;
+
+static __thread scratch_arena_t *scratch_arena = NULL;
+
+static struct {
+    ErlNifMutex *lock;
+    scratch_arena_t *arenas;
+} scratch;
+
+/**
+ * Set up the arena list
+ * @brief scratch_init
+ * @return 1 on success, 0 otherwise
+ */
+static int scratch_init(void) {
+    scratch.lock = enif_mutex_create("excairo_scratch_lock");
+    scratch.arenas = NULL;
+    return scratch.lock != NULL;
+}
+
+/**
+ * Free the arenas of all threads. Only called on unload, when no NIF
+ * is running anymore.
+ * @brief scratch_destroy
+ */
+static void scratch_destroy(void) {
+    if (!scratch.lock) {
+        return;
+    }
+
+    while (scratch.arenas) {
+        scratch_arena_t *arena = scratch.arenas;
+        scratch.arenas = arena->next;
+
+        int i;
+        for (i = 0; i < SCRATCH_SLOTS; i++) {
+            if (arena->slots[i].data) {
+                enif_free(arena->slots[i].data);
+            }
+        }
+        enif_free(arena);
+    }
+
+    enif_mutex_destroy(scratch.lock);
+    scratch.lock = NULL;
+}
+
+/**
+ * Get the arena of the calling thread, creating it on first use
+ * @brief scratch_thread_arena
+ * @return the arena or NULL if memory ran out
+ */
+static scratch_arena_t *scratch_thread_arena(void) {
+    if (scratch_arena) {
+        return scratch_arena;
     }
+
+    scratch_arena_t *arena = enif_alloc(sizeof(scratch_arena_t));
+    if (!arena) {
+        return NULL;
+    }
+    memset(arena, 0, sizeof(scratch_arena_t));
+
+    enif_mutex_lock(scratch.lock);
+    arena->next = scratch.arenas;
+    scratch.arenas = arena;
+    enif_mutex_unlock(scratch.lock);
+
+    scratch_arena = arena;
+    return arena;
+}
+
+/**
+ * Get a binary argument as a NUL terminated string. A binary that
+ * already ends with a NUL byte is used in place; everything else is
+ * copied into the scratch slot of the argument position, which is
+ * reused by later calls on the same thread. The string is valid until
+ * the next call for the same position returns.
+ * @brief scratch_string
+ * @return the string or NULL if term is not a binary
+ */
+static const char *scratch_string(ErlNifEnv *env, ERL_NIF_TERM term, int pos) {
+    ErlNifBinary bin;
+    if (!enif_inspect_binary(env, term, &bin) || pos < 0 || pos >= SCRATCH_SLOTS) {
+        return NULL;
+    }
+
+    if (bin.size > 0 && bin.data[bin.size - 1] == '\0') {
+        return (const char *) bin.data;
+    }
+
+    scratch_arena_t *arena = scratch_thread_arena();
+    if (!arena) {
+        return NULL;
+    }
+
+    scratch_slot_t *slot = &arena->slots[pos];
+    size_t needed = bin.size + 1;
+
+    if (needed > slot->capacity ||
+        (slot->capacity > SCRATCH_RETAINED_SIZE && needed <= SCRATCH_RETAINED_SIZE)) {
+        size_t capacity = needed > 256 ? needed : 256;
+        char *data = enif_realloc(slot->data, capacity);
+        if (!data) {
+            return NULL;
+        }
+        slot->data = data;
+        slot->capacity = capacity;
+    }
+
+    memcpy(slot->data, bin.data, bin.size);
+    slot->data[bin.size] = '\0';
+    return slot->data;
 }
 
 // --------------------------------------------------------------------------------
@@ -222,6 +420,7 @@ static ErlNifResourceType *cairo_surface_t_RT = NULL;
  */
 typedef struct {
     cairo_surface_t *data;
+    resource_lock_t lock;
 } cairo_surface_t_TYPE;
 
 /**
@@ -233,7 +432,7 @@ typedef struct {
  */
 static void gc_cairo_surface_t (ErlNifEnv *env, void *instance) {
     cairo_surface_t_TYPE* surface = (cairo_surface_t_TYPE *) instance;
-    if (env && surface && surface->data) {
+    if (env && surface && surface->data && !surface_pool_checkin(surface->data)) {
         cairo_surface_destroy(surface->data);
     }
 }
@@ -241,6 +440,59 @@ static void gc_cairo_surface_t (ErlNifEnv *env, void *instance) {
 // --------------------------------------------------------------------------------
 
 
+// cairo_t
+// --------------------------------------------------------------------------------
+
+/**
+ * Erlang Resource Type representing a
+ * cairo_t
+ * @brief cairo_t_RT
+ */
+static ErlNifResourceType *cairo_t_RT = NULL;
+
+/**
+ * Struct to use in place of cairo_surface_t when
+ * allocating resources with enif_alloc_resource
+ */
+typedef struct {
+    cairo_t *data;
+    resource_lock_t lock;
+    // Kept reference to the surface the context draws on
+    cairo_surface_t_TYPE *target;
+} cairo_t_TYPE;
+
+/**
+ * Destructor function to enable garbage collection of
+ * cairo_surface_t instances
+ * @brief gc_cairo_surface_t
+ * @param env Erlang environment
+ * @param instance wraps a cairo_surface_t instance
+ */
+static void gc_cairo_t (ErlNifEnv *env, void *instance) {
+    cairo_t_TYPE* context = (cairo_t_TYPE *) instance;
+    if (env && context && context->data) {
+        cairo_destroy(context->data);
+    }
+    if (context && context->target) {
+        enif_release_resource(context->target);
+    }
+}
+
+// Take the lock of the surface a context draws on for the rest of the
+// enclosing scope, next to the lock of the context itself. Returns
+// {:error, :busy} from the NIF if another caller holds it. Cached
+// rasterizations of a recording target are dropped, it is drawn to next.
+#define ERL_LOCK_TARGET(name) \
+    resource_lock_t *name ## _target_lock __attribute__((cleanup(release_scoped_lock))) = NULL; \
+    if (name->target) { \
+        if (!resource_trylock(&name->target->lock, LOCK_THREAD_TOKEN)) return ERL_BUSY; \
+        name ## _target_lock = &name->target->lock; \
+        raster_cache_invalidate(name->target->data); \
+    }
+
+// --------------------------------------------------------------------------------
+
+
 // cairo_path_t
 // --------------------------------------------------------------------------------
 
@@ -275,6 +527,41 @@ static void gc_cairo_path_t (ErlNifEnv *env, void *instance) {
 
 // --------------------------------------------------------------------------------
 
+// display_list_t
+// --------------------------------------------------------------------------------
+
+/**
+ * Erlang Resource Type representing a
+ * compiled list of draw operations
+ * @brief display_list_t_RT
+ */
+static ErlNifResourceType *display_list_t_RT = NULL;
+
+/**
+ * A sequence of decoded draw operations that can be replayed
+ * against any context without decoding erlang terms again
+ */
+typedef struct {
+    draw_op_t *ops;
+    size_t count;
+} display_list_t_TYPE;
+
+/**
+ * Destructor function to enable garbage collection of
+ * display lists
+ * @brief gc_display_list_t
+ * @param env Erlang environment
+ * @param instance wraps a display_list_t_TYPE instance
+ */
+static void gc_display_list_t (ErlNifEnv *env, void *instance) {
+    display_list_t_TYPE* list = (display_list_t_TYPE *) instance;
+    if (env && list && list->ops) {
+        enif_free(list->ops);
+    }
+}
+
+// --------------------------------------------------------------------------------
+
 // cairo_font_face_t
 // --------------------------------------------------------------------------------
 
@@ -343,6 +630,41 @@ static void gc_cairo_font_options_t (ErlNifEnv *env, void *instance) {
 
 // --------------------------------------------------------------------------------
 
+// cairo_scaled_font_t
+// --------------------------------------------------------------------------------
+
+/**
+ * Erlang Resource Type representing a
+ * cairo_scaled_font_t
+ * @brief cairo_scaled_font_t_RT
+ */
+static ErlNifResourceType *cairo_scaled_font_t_RT = NULL;
+
+/**
+ * Struct to use in place of cairo_scaled_font_t when
+ * allocating resources with enif_alloc_resource.
+ * cairo guards scaled fonts internally, so no lock is needed.
+ */
+typedef struct {
+    cairo_scaled_font_t *data;
+} cairo_scaled_font_t_TYPE;
+
+/**
+ * Destructor function to enable garbage collection of
+ * cairo_scaled_font_t instances
+ * @brief gc_cairo_scaled_font_t
+ * @param env Erlang environment
+ * @param instance wraps a cairo_scaled_font_t instance
+ */
+static void gc_cairo_scaled_font_t (ErlNifEnv *env, void *instance) {
+    cairo_scaled_font_t_TYPE* font = (cairo_scaled_font_t_TYPE *) instance;
+    if (env && font && font->data) {
+        cairo_scaled_font_destroy(font->data);
+    }
+}
+
+// --------------------------------------------------------------------------------
+
 // cairo_pattern_t
 // --------------------------------------------------------------------------------
 
@@ -394,6 +716,7 @@ static ErlNifResourceType *cairo_region_t_RT = NULL;
  */
 typedef struct {
     cairo_region_t *data;
+    resource_lock_t lock;
 } cairo_region_t_TYPE;
 
 /**
@@ -410,4 +733,467 @@ static void gc_cairo_region_t (ErlNifEnv *env, void *instance) {
     }
 }
 
+/**
+ * Wrap a new region in a resource, taking ownership of it
+ * @brief make_region
+ * @return {:ok, region} or badarg if the region is in an error state
+ */
+static ERL_NIF_TERM make_region(ErlNifEnv *env, cairo_region_t *data) {
+    if (cairo_region_status(data) != CAIRO_STATUS_SUCCESS) {
+        cairo_region_destroy(data);
+        return enif_make_badarg(env);
+    }
+
+    ERL_MAKE_INSTANCE(cairo_region_t_TYPE, cairo_region_t_RT, instance);
+    if (!instance) {
+        cairo_region_destroy(data);
+        return enif_make_badarg(env);
+    }
+
+    instance->data = data;
+
+    ERL_MAKE_GC_RES(instance, term);
+    return ERL_MAKE_OK_TUPLE(term);
+}
+
+// --------------------------------------------------------------------------------
+
+// cairo_matrix_t
+// --------------------------------------------------------------------------------
+
+/**
+ * Erlang Resource Type representing a
+ * cairo_matrix_t
+ * @brief cairo_matrix_t_RT
+ */
+static ErlNifResourceType *cairo_matrix_t_RT = NULL;
+
+/**
+ * A matrix that is modified in place. The matrix is stored inline,
+ * there is nothing to free when the resource is collected.
+ */
+typedef struct {
+    cairo_matrix_t data;
+    resource_lock_t lock;
+} cairo_matrix_t_TYPE;
+
+/**
+ * Wrap a copy of a matrix in a new resource
+ * @brief make_matrix
+ * @return {:ok, matrix} or badarg if the resource can't be allocated
+ */
+static ERL_NIF_TERM make_matrix(ErlNifEnv *env, const cairo_matrix_t *matrix) {
+    ERL_MAKE_INSTANCE(cairo_matrix_t_TYPE, cairo_matrix_t_RT, instance);
+    ERL_ASSERT(instance);
+
+    instance->data = *matrix;
+
+    ERL_MAKE_GC_RES(instance, term);
+    return ERL_MAKE_OK_TUPLE(term);
+}
+
+/**
+ * Read a matrix from a matrix resource or a
+ * {{xx, yx}, {xy, yy}, {x0, y0}} tuple
+ * @brief import_matrix
+ * @return 1 on success, 0 if the term is not a matrix and -1 if the
+ * resource is locked by another caller
+ */
+static int import_matrix(ErlNifEnv *env, ERL_NIF_TERM term, cairo_matrix_t *matrix) {
+    cairo_matrix_t_TYPE *resource;
+    if (enif_get_resource(env, term, cairo_matrix_t_RT, (void **) &resource)) {
+        if (!resource_trylock(&resource->lock, LOCK_THREAD_TOKEN)) {
+            return -1;
+        }
+        *matrix = resource->data;
+        resource_unlock(&resource->lock);
+        return 1;
+    }
+
+    int arity;
+    const ERL_NIF_TERM *rows;
+    if (!enif_get_tuple(env, term, &arity, &rows) || arity != 3) {
+        return 0;
+    }
+
+    double *fields[3][2] = {
+        { &matrix->xx, &matrix->yx },
+        { &matrix->xy, &matrix->yy },
+        { &matrix->x0, &matrix->y0 }
+    };
+
+    int i;
+    for (i = 0; i < 3; i++) {
+        const ERL_NIF_TERM *row;
+        if (!enif_get_tuple(env, rows[i], &arity, &row) || arity != 2 ||
+            !get_number(env, row[0], fields[i][0]) || !get_number(env, row[1], fields[i][1])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Size of one <<x::float-64, y::float-64>> point
+#define PACKED_POINT_SIZE 16
+
+// Points transformed per block by matrix_transform_points
+#define POINT_BLOCK 256
+
+// --------------------------------------------------------------------------------
+
+
+// Packed glyphs
+// --------------------------------------------------------------------------------
+
+// Size of one <<index::32, x::float-64, y::float-64>> record
+#define PACKED_GLYPH_SIZE 20
+
+// Glyph arrays up to this length are decoded on the stack
+#define STACK_GLYPHS 64
+
+/**
+ * Encode glyphs as packed records into a new binary term
+ * @brief make_packed_glyphs
+ * @return the binary term
+ */
+static ERL_NIF_TERM make_packed_glyphs(ErlNifEnv *env, const cairo_glyph_t *glyphs, int count) {
+    ERL_NIF_TERM term;
+    unsigned char *data = enif_make_new_binary(env, (size_t) count * PACKED_GLYPH_SIZE, &term);
+
+    int i;
+    for (i = 0; i < count; i++, data += PACKED_GLYPH_SIZE) {
+        unsigned long index = glyphs[i].index;
+        data[0] = (unsigned char) (index >> 24);
+        data[1] = (unsigned char) (index >> 16);
+        data[2] = (unsigned char) (index >> 8);
+        data[3] = (unsigned char) index;
+        write_double_be(data + 4, glyphs[i].x);
+        write_double_be(data + 12, glyphs[i].y);
+    }
+
+    return term;
+}
+
+/**
+ * Decode packed glyph records into glyphs, which must have room for
+ * size / PACKED_GLYPH_SIZE entries
+ * @brief read_packed_glyphs
+ * @return the number of glyphs
+ */
+static int read_packed_glyphs(const unsigned char *data, size_t size, cairo_glyph_t *glyphs) {
+    int count = (int) (size / PACKED_GLYPH_SIZE);
+
+    int i;
+    for (i = 0; i < count; i++, data += PACKED_GLYPH_SIZE) {
+        glyphs[i].index = ((unsigned long) data[0] << 24) | ((unsigned long) data[1] << 16) |
+                          ((unsigned long) data[2] << 8) | (unsigned long) data[3];
+        glyphs[i].x = read_double_be(data + 4);
+        glyphs[i].y = read_double_be(data + 12);
+    }
+
+    return count;
+}
+
+// --------------------------------------------------------------------------------
+
+// Packed paths
+// --------------------------------------------------------------------------------
+
+/**
+ * Number of points following each cairo_path_data_type_t in the
+ * packed <<op::8, points::float-64...>> encoding. The op codes are the
+ * values of cairo_path_data_type_t (0 move_to, 1 line_to, 2 curve_to,
+ * 3 close_path).
+ */
+static const int packed_path_points[4] = { 1, 1, 3, 0 };
+
+/**
+ * Encode a cairo path into a new binary term
+ * @brief make_packed_path
+ * @return the binary term
+ */
+static ERL_NIF_TERM make_packed_path(ErlNifEnv *env, const cairo_path_t *path) {
+    size_t size = 0;
+    int i;
+    for (i = 0; i < path->num_data; i += path->data[i].header.length) {
+        size += 1 + (size_t) (path->data[i].header.length - 1) * 16;
+    }
+
+    ERL_NIF_TERM term;
+    unsigned char *out = enif_make_new_binary(env, size, &term);
+
+    for (i = 0; i < path->num_data; i += path->data[i].header.length) {
+        const cairo_path_data_t *element = &path->data[i];
+        *out++ = (unsigned char) element->header.type;
+
+        int j;
+        for (j = 1; j < element->header.length; j++) {
+            write_double_be(out, element[j].point.x);
+            write_double_be(out + 8, element[j].point.y);
+            out += 16;
+        }
+    }
+
+    return term;
+}
+
+/**
+ * Decode a packed path into path->data, allocated with enif_alloc.
+ * The caller owns the data and must enif_free it.
+ * @brief read_packed_path
+ * @return 1 on success. On failure 0 is returned and *failed holds the
+ * byte offset of the first malformed element.
+ */
+static int read_packed_path(const ErlNifBinary *bin, cairo_path_t *path, size_t *failed) {
+    size_t offset = 0;
+    int num_data = 0;
+
+    path->status = CAIRO_STATUS_SUCCESS;
+    path->data = NULL;
+    path->num_data = 0;
+
+    // First pass validates and counts the cairo_path_data_t entries
+    while (offset < bin->size) {
+        int op = bin->data[offset];
+        if (op > CAIRO_PATH_CLOSE_PATH || bin->size - offset - 1 < (size_t) packed_path_points[op] * 16) {
+            *failed = offset;
+            return 0;
+        }
+        offset += 1 + packed_path_points[op] * 16;
+        num_data += 1 + packed_path_points[op];
+    }
+
+    path->data = enif_alloc(sizeof(cairo_path_data_t) * (num_data ? num_data : 1));
+    if (!path->data) {
+        *failed = 0;
+        return 0;
+    }
+
+    cairo_path_data_t *element = path->data;
+    for (offset = 0; offset < bin->size; ) {
+        int op = bin->data[offset++];
+        int points = packed_path_points[op];
+
+        element->header.type = (cairo_path_data_type_t) op;
+        element->header.length = 1 + points;
+
+        int j;
+        for (j = 1; j <= points; j++) {
+            element[j].point.x = read_double_be(bin->data + offset);
+            element[j].point.y = read_double_be(bin->data + offset + 8);
+            offset += 16;
+        }
+        element += 1 + points;
+    }
+
+    path->num_data = num_data;
+    return 1;
+}
+
+// --------------------------------------------------------------------------------
+
+// Packed rectangles
+// --------------------------------------------------------------------------------
+
+// Size of one <<x::32, y::32, width::32, height::32>> record of signed
+// integers
+#define PACKED_RECTANGLE_SIZE 16
+
+// Rectangle arrays up to this length are decoded on the stack
+#define STACK_RECTANGLES 64
+
+static inline int read_int32_be(const unsigned char *data) {
+    return (int) (((unsigned) data[0] << 24) | ((unsigned) data[1] << 16) |
+                  ((unsigned) data[2] << 8) | (unsigned) data[3]);
+}
+
+static inline void write_int32_be(unsigned char *data, int value) {
+    unsigned bits = (unsigned) value;
+    data[0] = (unsigned char) (bits >> 24);
+    data[1] = (unsigned char) (bits >> 16);
+    data[2] = (unsigned char) (bits >> 8);
+    data[3] = (unsigned char) bits;
+}
+
+/**
+ * Encode the rectangles of a region into a new binary term
+ * @brief make_packed_region
+ * @return the binary term
+ */
+static ERL_NIF_TERM make_packed_region(ErlNifEnv *env, const cairo_region_t *region) {
+    int count = cairo_region_num_rectangles(region);
+
+    ERL_NIF_TERM term;
+    unsigned char *data = enif_make_new_binary(env, (size_t) count * PACKED_RECTANGLE_SIZE, &term);
+
+    int i;
+    for (i = 0; i < count; i++, data += PACKED_RECTANGLE_SIZE) {
+        cairo_rectangle_int_t rect;
+        cairo_region_get_rectangle(region, i, &rect);
+        write_int32_be(data, rect.x);
+        write_int32_be(data + 4, rect.y);
+        write_int32_be(data + 8, rect.width);
+        write_int32_be(data + 12, rect.height);
+    }
+
+    return term;
+}
+
+/**
+ * Create a region from a binary of packed rectangles. Short inputs
+ * are decoded on the stack.
+ * @brief read_packed_region
+ * @return the region, NULL if bin is not a whole number of rectangles
+ * or memory ran out
+ */
+static cairo_region_t *read_packed_region(const ErlNifBinary *bin) {
+    if (bin->size % PACKED_RECTANGLE_SIZE != 0 || bin->size / PACKED_RECTANGLE_SIZE > INT_MAX) {
+        return NULL;
+    }
+
+    int count = (int) (bin->size / PACKED_RECTANGLE_SIZE);
+
+    cairo_rectangle_int_t stack_rects[STACK_RECTANGLES];
+    cairo_rectangle_int_t *rects = stack_rects;
+    if (count > STACK_RECTANGLES) {
+        rects = enif_alloc(sizeof(cairo_rectangle_int_t) * count);
+        if (!rects) {
+            return NULL;
+        }
+    }
+
+    const unsigned char *data = bin->data;
+    int i;
+    for (i = 0; i < count; i++, data += PACKED_RECTANGLE_SIZE) {
+        rects[i].x = read_int32_be(data);
+        rects[i].y = read_int32_be(data + 4);
+        rects[i].width = read_int32_be(data + 8);
+        rects[i].height = read_int32_be(data + 12);
+    }
+
+    cairo_region_t *region = cairo_region_create_rectangles(rects, count);
+
+    if (rects != stack_rects) {
+        enif_free(rects);
+    }
+
+    if (cairo_region_status(region) != CAIRO_STATUS_SUCCESS) {
+        cairo_region_destroy(region);
+        return NULL;
+    }
+
+    return region;
+}
+
+// --------------------------------------------------------------------------------
+
+// Batch hit testing
+// --------------------------------------------------------------------------------
+
+/**
+ * Erlang Resource Type holding the progress of a batch hit test
+ * across yields
+ * @brief hit_test_t_RT
+ */
+static ErlNifResourceType *hit_test_t_RT = NULL;
+
+typedef enum {
+    HIT_TEST_FILL,
+    HIT_TEST_STROKE,
+    HIT_TEST_CLIP
+} hit_test_kind_t;
+
+/**
+ * The bitset being filled in, one bit per point, most significant bit
+ * first. The test owns the lock of the context and keeps it alive
+ * until the last point is done, so the path can't change in between.
+ */
+typedef struct {
+    hit_test_kind_t kind;
+    unsigned char *bits;
+    size_t size;
+    cairo_t_TYPE *context;
+} hit_test_t;
+
+/**
+ * Give up the context of a hit test
+ * @brief hit_test_release_context
+ */
+static void hit_test_release_context(hit_test_t *test) {
+    if (test->context) {
+        resource_unlock(&test->context->lock);
+        enif_release_resource(test->context);
+        test->context = NULL;
+    }
+}
+
+/**
+ * Destructor function freeing the bitset of a hit test, and releasing
+ * the context of a test that did not run to completion
+ * @brief gc_hit_test_t
+ * @param env Erlang environment
+ * @param instance a hit_test_t
+ */
+static void gc_hit_test_t (ErlNifEnv *env, void *instance) {
+    hit_test_t *test = (hit_test_t *) instance;
+    if (test) {
+        hit_test_release_context(test);
+    }
+    if (test && test->bits) {
+        enif_free(test->bits);
+    }
+}
+
+// --------------------------------------------------------------------------------
+// Packed point paths
 // --------------------------------------------------------------------------------
+
+/**
+ * Erlang Resource Type holding the context of a points to path call
+ * across yields
+ * @brief points_path_t_RT
+ */
+static ErlNifResourceType *points_path_t_RT = NULL;
+
+/**
+ * The job owns the lock of the context until the last point is added,
+ * so no other call sees or changes a half built path
+ */
+typedef struct {
+    int close;
+    cairo_t_TYPE *context;
+} points_path_t;
+
+/**
+ * Give up the context of a points to path call
+ * @brief points_path_release_context
+ */
+static void points_path_release_context(points_path_t *job) {
+    if (job->context) {
+        resource_unlock(&job->context->lock);
+        enif_release_resource(job->context);
+        job->context = NULL;
+    }
+}
+
+/**
+ * Destructor function releasing the context of a points to path call
+ * that did not run to completion
+ * @brief gc_points_path_t
+ * @param env Erlang environment
+ * @param instance a points_path_t
+ */
+static void gc_points_path_t (ErlNifEnv *env, void *instance) {
+    points_path_t *job = (points_path_t *) instance;
+    if (job) {
+        points_path_release_context(job);
+    }
+}
+
+// --------------------------------------------------------------------------------
+
+#include "excairo_pool.h"
+#include "excairo_png.h"
+
+#endif // EXCAIRO_NIF_H
@@ -0,0 +1,362 @@
+#ifndef EXCAIRO_OPS_H
+#define EXCAIRO_OPS_H
+
+// Draw operations
+// --------------------------------------------------------------------------------
+
+/**
+ * Opcodes understood by `execute`. The numeric values are part of the
+ * packed binary format (<<opcode::8, args::float-64...>>) and must
+ * never be reordered.
+ */
+typedef enum {
+    OP_NEW_PATH = 0,
+    OP_NEW_SUB_PATH,
+    OP_CLOSE_PATH,
+    OP_MOVE_TO,
+    OP_LINE_TO,
+    OP_REL_MOVE_TO,
+    OP_REL_LINE_TO,
+    OP_CURVE_TO,
+    OP_REL_CURVE_TO,
+    OP_ARC,
+    OP_ARC_NEGATIVE,
+    OP_RECTANGLE,
+    OP_STROKE,
+    OP_STROKE_PRESERVE,
+    OP_FILL,
+    OP_FILL_PRESERVE,
+    OP_PAINT,
+    OP_PAINT_WITH_ALPHA,
+    OP_CLIP,
+    OP_CLIP_PRESERVE,
+    OP_RESET_CLIP,
+    OP_SAVE,
+    OP_RESTORE,
+    OP_TRANSLATE,
+    OP_SCALE,
+    OP_ROTATE,
+    OP_SET_SOURCE_RGB,
+    OP_SET_SOURCE_RGBA,
+    OP_SET_LINE_WIDTH,
+    OP_SET_FONT_SIZE,
+    OP_COUNT
+} draw_op_code_t;
+
+#define MAX_OP_ARGS 6
+
+/**
+ * A single decoded draw operation
+ */
+typedef struct {
+    draw_op_code_t code;
+    double args[MAX_OP_ARGS];
+} draw_op_t;
+
+/**
+ * Name (as used in the tuple representation) and number of
+ * arguments of every opcode, indexed by draw_op_code_t
+ */
+static const struct {
+    const char *name;
+    int argc;
+} draw_op_specs[OP_COUNT] = {
+    { "new_path",           0 },
+    { "new_sub_path",       0 },
+    { "close_path",         0 },
+    { "move_to",            2 },
+    { "line_to",            2 },
+    { "rel_move_to",        2 },
+    { "rel_line_to",        2 },
+    { "curve_to",           6 },
+    { "rel_curve_to",       6 },
+    { "arc",                5 },
+    { "arc_negative",       5 },
+    { "rectangle",          4 },
+    { "stroke",             0 },
+    { "stroke_preserve",    0 },
+    { "fill",               0 },
+    { "fill_preserve",      0 },
+    { "paint",              0 },
+    { "paint_with_alpha",   1 },
+    { "clip",               0 },
+    { "clip_preserve",      0 },
+    { "reset_clip",         0 },
+    { "save",               0 },
+    { "restore",            0 },
+    { "translate",          2 },
+    { "scale",              2 },
+    { "rotate",             1 },
+    { "set_source_rgb",     3 },
+    { "set_source_rgba",    4 },
+    { "set_line_width",     1 },
+    { "set_font_size",      1 }
+};
+
+// Atoms for the tuple representation, indexed by draw_op_code_t
+static ERL_NIF_TERM ET_ops[OP_COUNT];
+
+/**
+ * Create the opcode atoms. Must be called from the load function.
+ * @brief define_op_atoms
+ * @param env
+ */
+static void define_op_atoms(ErlNifEnv *env) {
+    int i;
+    for (i = 0; i < OP_COUNT; i++) {
+        ET_ops[i] = enif_make_atom(env, draw_op_specs[i].name);
+    }
+}
+
+/**
+ * Read a number from a term. Unlike enif_get_double this also
+ * accepts integers.
+ * @brief get_number
+ * @return 1 on success, 0 otherwise
+ */
+static int get_number(ErlNifEnv *env, ERL_NIF_TERM term, double *target) {
+    if (enif_get_double(env, term, target)) {
+        return 1;
+    }
+
+    long value;
+    if (enif_get_long(env, term, &value)) {
+        *target = (double) value;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Read a big endian IEEE 754 double (Elixir's default float-64)
+ * @brief read_double_be
+ */
+static inline double read_double_be(const unsigned char *data) {
+    union { unsigned long long bits; double value; } u;
+    u.bits = ((unsigned long long) data[0] << 56) |
+             ((unsigned long long) data[1] << 48) |
+             ((unsigned long long) data[2] << 40) |
+             ((unsigned long long) data[3] << 32) |
+             ((unsigned long long) data[4] << 24) |
+             ((unsigned long long) data[5] << 16) |
+             ((unsigned long long) data[6] << 8)  |
+             ((unsigned long long) data[7]);
+    return u.value;
+}
+
+/**
+ * Write a double as big endian IEEE 754 (Elixir's default float-64)
+ * @brief write_double_be
+ */
+static inline void write_double_be(unsigned char *data, double value) {
+    union { unsigned long long bits; double value; } u;
+    u.value = value;
+    int i;
+    for (i = 7; i >= 0; i--) {
+        data[i] = (unsigned char) u.bits;
+        u.bits >>= 8;
+    }
+}
+
+/**
+ * Decode one operation from its tuple representation, e.g.
+ * {:move_to, x, y} or {:stroke}. Operations without arguments may
+ * also be given as a bare atom.
+ * @brief decode_op_term
+ * @return 1 on success, 0 otherwise
+ */
+static int decode_op_term(ErlNifEnv *env, ERL_NIF_TERM term, draw_op_t *op) {
+    int arity = 1;
+    const ERL_NIF_TERM *tuple = &term;
+
+    if (!enif_is_atom(env, term) && !enif_get_tuple(env, term, &arity, &tuple)) {
+        return 0;
+    }
+
+    int code;
+    for (code = 0; code < OP_COUNT; code++) {
+        if (enif_compare(tuple[0], ET_ops[code]) == 0) {
+            break;
+        }
+    }
+
+    if (code == OP_COUNT || arity != draw_op_specs[code].argc + 1) {
+        return 0;
+    }
+
+    op->code = (draw_op_code_t) code;
+
+    int i;
+    for (i = 1; i < arity; i++) {
+        if (!get_number(env, tuple[i], &op->args[i - 1])) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Decode one operation from a packed binary starting at *offset.
+ * On success *offset is advanced past the operation.
+ * @brief decode_op_packed
+ * @return 1 on success, 0 otherwise
+ */
+static int decode_op_packed(const ErlNifBinary *bin, size_t *offset, draw_op_t *op) {
+    if (*offset >= bin->size) {
+        return 0;
+    }
+
+    int code = bin->data[*offset];
+    if (code >= OP_COUNT) {
+        return 0;
+    }
+
+    int argc = draw_op_specs[code].argc;
+    if (bin->size - *offset - 1 < (size_t) argc * 8) {
+        return 0;
+    }
+
+    op->code = (draw_op_code_t) code;
+
+    const unsigned char *args = bin->data + *offset + 1;
+    int i;
+    for (i = 0; i < argc; i++) {
+        op->args[i] = read_double_be(args + i * 8);
+    }
+
+    *offset += 1 + argc * 8;
+    return 1;
+}
+
+/**
+ * Decode a whole batch of operations (a list or a packed binary)
+ * into an array allocated with enif_alloc. The caller owns the
+ * array and must enif_free it.
+ * @brief decode_ops
+ * @return 1 on success. On failure 0 is returned and *failed holds
+ * the index of the first malformed operation, or -1 if the batch is
+ * neither a list nor a binary (or memory ran out).
+ */
+static int decode_ops(ErlNifEnv *env, ERL_NIF_TERM term, draw_op_t **ops, size_t *count, int *failed) {
+    ErlNifBinary bin;
+    size_t n = 0, offset = 0;
+
+    *failed = -1;
+    *ops = NULL;
+    *count = 0;
+
+    if (enif_inspect_binary(env, term, &bin)) {
+        // First pass only counts records, validating the layout
+        while (offset < bin.size) {
+            int code = bin.data[offset];
+            if (code >= OP_COUNT || bin.size - offset - 1 < (size_t) draw_op_specs[code].argc * 8) {
+                *failed = (int) n;
+                return 0;
+            }
+            offset += 1 + draw_op_specs[code].argc * 8;
+            n++;
+        }
+
+        *ops = enif_alloc(sizeof(draw_op_t) * (n ? n : 1));
+        if (!*ops) {
+            return 0;
+        }
+
+        size_t i;
+        for (i = 0, offset = 0; i < n; i++) {
+            decode_op_packed(&bin, &offset, &(*ops)[i]);
+        }
+    } else {
+        unsigned length;
+        if (!enif_get_list_length(env, term, &length)) {
+            return 0;
+        }
+
+        *ops = enif_alloc(sizeof(draw_op_t) * (length ? length : 1));
+        if (!*ops) {
+            return 0;
+        }
+
+        ERL_NIF_TERM head, tail = term;
+        while (enif_get_list_cell(env, tail, &head, &tail)) {
+            if (!decode_op_term(env, head, &(*ops)[n])) {
+                enif_free(*ops);
+                *ops = NULL;
+                *failed = (int) n;
+                return 0;
+            }
+            n++;
+        }
+    }
+
+    *count = n;
+    return 1;
+}
+
+/**
+ * Apply a decoded operation to a cairo context
+ * @brief apply_op
+ * @return the status of the context after the operation
+ */
+static cairo_status_t apply_op(cairo_t *cr, const draw_op_t *op) {
+    const double *a = op->args;
+
+    switch (op->code) {
+    case OP_NEW_PATH:           cairo_new_path(cr); break;
+    case OP_NEW_SUB_PATH:       cairo_new_sub_path(cr); break;
+    case OP_CLOSE_PATH:         cairo_close_path(cr); break;
+    case OP_MOVE_TO:            cairo_move_to(cr, a[0], a[1]); break;
+    case OP_LINE_TO:            cairo_line_to(cr, a[0], a[1]); break;
+    case OP_REL_MOVE_TO:        cairo_rel_move_to(cr, a[0], a[1]); break;
+    case OP_REL_LINE_TO:        cairo_rel_line_to(cr, a[0], a[1]); break;
+    case OP_CURVE_TO:           cairo_curve_to(cr, a[0], a[1], a[2], a[3], a[4], a[5]); break;
+    case OP_REL_CURVE_TO:       cairo_rel_curve_to(cr, a[0], a[1], a[2], a[3], a[4], a[5]); break;
+    case OP_ARC:                cairo_arc(cr, a[0], a[1], a[2], a[3], a[4]); break;
+    case OP_ARC_NEGATIVE:       cairo_arc_negative(cr, a[0], a[1], a[2], a[3], a[4]); break;
+    case OP_RECTANGLE:          cairo_rectangle(cr, a[0], a[1], a[2], a[3]); break;
+    case OP_STROKE:             damage_note_stroke(cr); cairo_stroke(cr); break;
+    case OP_STROKE_PRESERVE:    damage_note_stroke(cr); cairo_stroke_preserve(cr); break;
+    case OP_FILL:               damage_note_fill(cr); cairo_fill(cr); break;
+    case OP_FILL_PRESERVE:      damage_note_fill(cr); cairo_fill_preserve(cr); break;
+    case OP_PAINT:              damage_note_paint(cr); cairo_paint(cr); break;
+    case OP_PAINT_WITH_ALPHA:   damage_note_paint(cr); cairo_paint_with_alpha(cr, a[0]); break;
+    case OP_CLIP:               cairo_clip(cr); break;
+    case OP_CLIP_PRESERVE:      cairo_clip_preserve(cr); break;
+    case OP_RESET_CLIP:         cairo_reset_clip(cr); break;
+    case OP_SAVE:               cairo_save(cr); break;
+    case OP_RESTORE:            cairo_restore(cr); break;
+    case OP_TRANSLATE:          cairo_translate(cr, a[0], a[1]); break;
+    case OP_SCALE:              cairo_scale(cr, a[0], a[1]); break;
+    case OP_ROTATE:             cairo_rotate(cr, a[0]); break;
+    case OP_SET_SOURCE_RGB:     cairo_set_source_rgb(cr, a[0], a[1], a[2]); break;
+    case OP_SET_SOURCE_RGBA:    cairo_set_source_rgba(cr, a[0], a[1], a[2], a[3]); break;
+    case OP_SET_LINE_WIDTH:     cairo_set_line_width(cr, a[0]); break;
+    case OP_SET_FONT_SIZE:      cairo_set_font_size(cr, a[0]); break;
+    default:
+        return CAIRO_STATUS_INVALID_STATUS;
+    }
+
+    return cairo_status(cr);
+}
+
+/**
+ * Apply an array of decoded operations, stopping at the first one
+ * that leaves the context in an error state
+ * @brief apply_ops
+ * @return the index of the failing operation, -1 if all succeeded
+ */
+static int apply_ops(cairo_t *cr, const draw_op_t *ops, size_t count) {
+    size_t i;
+    for (i = 0; i < count; i++) {
+        if (apply_op(cr, &ops[i]) != CAIRO_STATUS_SUCCESS) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+// --------------------------------------------------------------------------------
+
+#endif // EXCAIRO_OPS_H
@@ -0,0 +1,200 @@
+#ifndef EXCAIRO_PNG_H
+#define EXCAIRO_PNG_H
+
+// In-memory PNG streams
+// --------------------------------------------------------------------------------
+
+// Initial capacity of the buffer an encoded PNG is written to
+#define PNG_BUFFER_INITIAL_SIZE (16 * 1024)
+
+/**
+ * Destination of cairo_surface_write_to_png_stream. The encoder
+ * appends to a single binary that grows geometrically.
+ */
+typedef struct {
+    ErlNifBinary bin;
+    size_t length;
+} png_buffer_t;
+
+/**
+ * cairo_write_func_t appending to a png_buffer_t
+ * @brief png_buffer_write
+ * @return CAIRO_STATUS_WRITE_ERROR if the buffer could not grow
+ */
+static cairo_status_t png_buffer_write(void *closure, const unsigned char *data, unsigned int length) {
+    png_buffer_t *buffer = (png_buffer_t *) closure;
+
+    if (buffer->length + length > buffer->bin.size) {
+        size_t capacity = buffer->bin.size * 2;
+        while (capacity < buffer->length + length) {
+            capacity *= 2;
+        }
+        if (!enif_realloc_binary(&buffer->bin, capacity)) {
+            return CAIRO_STATUS_WRITE_ERROR;
+        }
+    }
+
+    memcpy(buffer->bin.data + buffer->length, data, length);
+    buffer->length += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/**
+ * Encode a surface as PNG into buffer->bin. On success the binary is
+ * trimmed to the encoded size and owned by the caller, who must turn
+ * it into a term or release it. On failure nothing has to be freed.
+ * @brief png_encode_surface
+ * @return the status of the encoder
+ */
+static cairo_status_t png_encode_surface(cairo_surface_t *surface, png_buffer_t *buffer) {
+    buffer->length = 0;
+    if (!enif_alloc_binary(PNG_BUFFER_INITIAL_SIZE, &buffer->bin)) {
+        return CAIRO_STATUS_NO_MEMORY;
+    }
+
+    cairo_status_t status = cairo_surface_write_to_png_stream(surface, png_buffer_write, buffer);
+    if (status == CAIRO_STATUS_SUCCESS && !enif_realloc_binary(&buffer->bin, buffer->length)) {
+        status = CAIRO_STATUS_NO_MEMORY;
+    }
+
+    if (status != CAIRO_STATUS_SUCCESS) {
+        enif_release_binary(&buffer->bin);
+    }
+    return status;
+}
+
+// PNG inputs without a readable header that are larger than this are
+// decoded on a dirty scheduler
+#define PNG_DIRTY_SIZE_THRESHOLD (64 * 1024)
+
+/**
+ * Pixel count of a PNG image, read from the width and height of the
+ * IHDR chunk that follows the signature, at bytes 16 to 23
+ * @brief png_image_area
+ * @return the area or -1 if the data doesn't start with a PNG header
+ */
+static long png_image_area(const unsigned char *data, size_t size) {
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (size < 24 || memcmp(data, signature, 8) != 0 || memcmp(data + 12, "IHDR", 4) != 0) {
+        return -1;
+    }
+
+    unsigned long width = ((unsigned long) data[16] << 24) | ((unsigned long) data[17] << 16) |
+                          ((unsigned long) data[18] << 8) | data[19];
+    unsigned long height = ((unsigned long) data[20] << 24) | ((unsigned long) data[21] << 16) |
+                           ((unsigned long) data[22] << 8) | data[23];
+
+    // Sides may be up to 2^31 - 1, clamp so the product fits a long
+    if (width > 0x7fff || height > 0x7fff) {
+        return LONG_MAX;
+    }
+    return (long) (width * height);
+}
+
+/**
+ * Source of cairo_image_surface_create_from_png_stream, a cursor
+ * over an inspected binary
+ */
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    size_t offset;
+} png_reader_t;
+
+/**
+ * cairo_read_func_t reading from a png_reader_t
+ * @brief png_reader_read
+ * @return CAIRO_STATUS_READ_ERROR if the input is exhausted
+ */
+static cairo_status_t png_reader_read(void *closure, unsigned char *data, unsigned int length) {
+    png_reader_t *reader = (png_reader_t *) closure;
+
+    if (reader->size - reader->offset < length) {
+        return CAIRO_STATUS_READ_ERROR;
+    }
+
+    memcpy(data, reader->data + reader->offset, length);
+    reader->offset += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+// Size of the chunks surface_stream_png sends while encoding
+#define PNG_CHUNK_SIZE (64 * 1024)
+
+/**
+ * Destination of a PNG encode that streams its output to a process as
+ * {:excairo_png_chunk, ref, chunk} messages. The ref lives in its own
+ * environment because msg_env is cleared by every send.
+ */
+typedef struct {
+    ErlNifPid pid;
+    ErlNifEnv *ref_env;
+    ERL_NIF_TERM ref;
+    ErlNifEnv *msg_env;
+    ErlNifBinary chunk;
+    size_t length;
+    int has_chunk;
+} png_stream_t;
+
+/**
+ * Send the buffered chunk, if any, to the receiver
+ * @brief png_stream_flush
+ * @return 0 if the receiver is gone or memory ran out
+ */
+static int png_stream_flush(png_stream_t *stream) {
+    if (!stream->has_chunk || stream->length == 0) {
+        return 1;
+    }
+
+    if (stream->length < stream->chunk.size && !enif_realloc_binary(&stream->chunk, stream->length)) {
+        return 0;
+    }
+
+    ErlNifEnv *env = stream->msg_env;
+    ERL_NIF_TERM chunk = enif_make_binary(env, &stream->chunk);
+    stream->has_chunk = 0;
+    stream->length = 0;
+
+    return enif_send(NULL, &stream->pid, env,
+                     enif_make_tuple3(env,
+                                      enif_make_atom(env, "excairo_png_chunk"),
+                                      enif_make_copy(env, stream->ref),
+                                      chunk));
+}
+
+/**
+ * cairo_write_func_t sending the output in PNG_CHUNK_SIZE chunks
+ * @brief png_stream_write
+ * @return CAIRO_STATUS_WRITE_ERROR to stop the encoder if the receiver
+ * is gone
+ */
+static cairo_status_t png_stream_write(void *closure, const unsigned char *data, unsigned int length) {
+    png_stream_t *stream = (png_stream_t *) closure;
+
+    while (length > 0) {
+        if (!stream->has_chunk) {
+            if (!enif_alloc_binary(PNG_CHUNK_SIZE, &stream->chunk)) {
+                return CAIRO_STATUS_NO_MEMORY;
+            }
+            stream->has_chunk = 1;
+            stream->length = 0;
+        }
+
+        size_t room = stream->chunk.size - stream->length;
+        size_t count = length < room ? length : room;
+        memcpy(stream->chunk.data + stream->length, data, count);
+        stream->length += count;
+        data += count;
+        length -= (unsigned int) count;
+
+        if (stream->length == stream->chunk.size && !png_stream_flush(stream)) {
+            return CAIRO_STATUS_WRITE_ERROR;
+        }
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+// --------------------------------------------------------------------------------
+
+#endif // EXCAIRO_PNG_H
@@ -0,0 +1,155 @@
+#ifndef EXCAIRO_POOL_H
+#define EXCAIRO_POOL_H
+
+// Native worker pool
+// --------------------------------------------------------------------------------
+
+/**
+ * A unit of work executed on one of the pool threads. The job owns
+ * its argument and is responsible for freeing it.
+ */
+typedef struct pool_job_t {
+    void (*run)(void *arg);
+    void *arg;
+    struct pool_job_t *next;
+} pool_job_t;
+
+/**
+ * A fixed number of native threads consuming a FIFO job queue
+ */
+typedef struct {
+    ErlNifMutex *lock;
+    ErlNifCond *cond;
+    pool_job_t *head;
+    pool_job_t *tail;
+    int stopping;
+    int num_threads;
+    ErlNifTid *threads;
+} worker_pool_t;
+
+static worker_pool_t pool;
+
+/**
+ * Thread main function. Runs jobs until the pool is stopped and
+ * the queue has been drained.
+ * @brief pool_worker
+ */
+static void *pool_worker(void *unused) {
+    for (;;) {
+        enif_mutex_lock(pool.lock);
+        while (!pool.head && !pool.stopping) {
+            enif_cond_wait(pool.cond, pool.lock);
+        }
+
+        pool_job_t *job = pool.head;
+        if (!job) {
+            // Stopping and nothing left to do
+            enif_mutex_unlock(pool.lock);
+            return NULL;
+        }
+
+        pool.head = job->next;
+        if (!pool.head) {
+            pool.tail = NULL;
+        }
+        enif_mutex_unlock(pool.lock);
+
+        job->run(job->arg);
+        enif_free(job);
+    }
+}
+
+/**
+ * Start the pool with the given number of threads. If not a single
+ * thread could be started everything created so far is freed again.
+ * @brief pool_start
+ * @return 1 on success, 0 otherwise
+ */
+static int pool_start(int num_threads) {
+    memset(&pool, 0, sizeof(pool));
+
+    pool.lock = enif_mutex_create("excairo_pool_lock");
+    pool.cond = enif_cond_create("excairo_pool_cond");
+    pool.threads = enif_alloc(sizeof(ErlNifTid) * num_threads);
+
+    int i;
+    for (i = 0; pool.lock && pool.cond && pool.threads && i < num_threads; i++) {
+        if (enif_thread_create("excairo_worker", &pool.threads[i], pool_worker, NULL, NULL) != 0) {
+            break;
+        }
+        pool.num_threads++;
+    }
+
+    if (pool.num_threads == 0) {
+        if (pool.threads) enif_free(pool.threads);
+        if (pool.cond) enif_cond_destroy(pool.cond);
+        if (pool.lock) enif_mutex_destroy(pool.lock);
+        memset(&pool, 0, sizeof(pool));
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Finish all queued jobs and join the pool threads
+ * @brief pool_stop
+ */
+static void pool_stop(void) {
+    if (!pool.lock) {
+        return;
+    }
+
+    enif_mutex_lock(pool.lock);
+    pool.stopping = 1;
+    enif_cond_broadcast(pool.cond);
+    enif_mutex_unlock(pool.lock);
+
+    int i;
+    for (i = 0; i < pool.num_threads; i++) {
+        enif_thread_join(pool.threads[i], NULL);
+    }
+
+    enif_free(pool.threads);
+    enif_cond_destroy(pool.cond);
+    enif_mutex_destroy(pool.lock);
+    memset(&pool, 0, sizeof(pool));
+}
+
+/**
+ * Queue a job. run(arg) is called on a pool thread.
+ * @brief pool_submit
+ * @return 1 on success, 0 if the job could not be queued
+ */
+static int pool_submit(void (*run)(void *arg), void *arg) {
+    pool_job_t *job = enif_alloc(sizeof(pool_job_t));
+    if (!job) {
+        return 0;
+    }
+
+    job->run = run;
+    job->arg = arg;
+    job->next = NULL;
+
+    enif_mutex_lock(pool.lock);
+    if (pool.stopping) {
+        enif_mutex_unlock(pool.lock);
+        enif_free(job);
+        return 0;
+    }
+
+    if (pool.tail) {
+        pool.tail->next = job;
+    } else {
+        pool.head = job;
+    }
+    pool.tail = job;
+
+    enif_cond_signal(pool.cond);
+    enif_mutex_unlock(pool.lock);
+    return 1;
+}
+
+// --------------------------------------------------------------------------------
+
+#endif // EXCAIRO_POOL_H
@@ -0,0 +1,296 @@
+#ifndef EXCAIRO_RASTER_CACHE_H
+#define EXCAIRO_RASTER_CACHE_H
+
+// Raster cache
+// --------------------------------------------------------------------------------
+
+#define RASTER_CACHE_BUCKETS 1024
+
+/**
+ * A rasterized recording surface. Cached surfaces are never drawn to
+ * again, so they can be read by several threads at once.
+ */
+typedef struct raster_entry_t {
+    unsigned long serial;
+    cairo_matrix_t matrix;
+    cairo_format_t format;
+    int width;
+    int height;
+    cairo_surface_t *surface;
+    size_t bytes;
+    struct raster_entry_t *prev;
+    struct raster_entry_t *next;
+    struct raster_entry_t *chain;
+} raster_entry_t;
+
+/**
+ * Rasterized recordings keyed by (recording, matrix, size, format).
+ * Entries are kept in a hash table and in a list ordered from most to
+ * least recently used. Least recently used entries are evicted when
+ * the cache grows past max_bytes; a limit of 0 (the default) disables
+ * the cache.
+ */
+typedef struct {
+    ErlNifMutex *lock;
+    raster_entry_t *buckets[RASTER_CACHE_BUCKETS];
+    raster_entry_t *head;
+    raster_entry_t *tail;
+    size_t bytes;
+    size_t max_bytes;
+    unsigned long entries;
+    unsigned long hits;
+    unsigned long misses;
+} raster_cache_t;
+
+static raster_cache_t raster_cache;
+
+/**
+ * Recording surfaces are identified by a serial number stored as user
+ * data, because the address of a destroyed surface can be reused
+ */
+static cairo_user_data_key_t recording_serial_key;
+static unsigned long recording_serial_counter;
+
+/**
+ * Create the cache mutex. Must be called from the load function.
+ * @brief raster_cache_init
+ * @return 1 on success, 0 otherwise
+ */
+static int raster_cache_init(void) {
+    memset(&raster_cache, 0, sizeof(raster_cache));
+    raster_cache.lock = enif_mutex_create("excairo_raster_cache_lock");
+    return raster_cache.lock != NULL;
+}
+
+/**
+ * Hash of a cache key
+ * @brief raster_cache_hash
+ */
+static unsigned raster_cache_hash(unsigned long serial, const cairo_matrix_t *matrix,
+                                  cairo_format_t format, int width, int height) {
+    // FNV-1a over the matrix, mixed with the remaining fields
+    const unsigned char *bytes = (const unsigned char *) matrix;
+    unsigned long hash = 2166136261UL ^ serial;
+    size_t i;
+    for (i = 0; i < sizeof(cairo_matrix_t); i++) {
+        hash = (hash ^ bytes[i]) * 16777619UL;
+    }
+    hash = (hash ^ (unsigned long) format) * 16777619UL;
+    hash = (hash ^ (unsigned long) width) * 16777619UL;
+    hash = (hash ^ (unsigned long) height) * 16777619UL;
+    return (unsigned) (hash % RASTER_CACHE_BUCKETS);
+}
+
+/**
+ * Remove an entry from the table and the list and destroy it. The
+ * cache lock must be held.
+ * @brief raster_cache_remove
+ */
+static void raster_cache_remove(raster_entry_t *entry) {
+    unsigned bucket = raster_cache_hash(entry->serial, &entry->matrix, entry->format, entry->width, entry->height);
+    raster_entry_t **link = &raster_cache.buckets[bucket];
+    while (*link != entry) {
+        link = &(*link)->chain;
+    }
+    *link = entry->chain;
+
+    if (entry->prev) entry->prev->next = entry->next; else raster_cache.head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev; else raster_cache.tail = entry->prev;
+
+    raster_cache.bytes -= entry->bytes;
+    raster_cache.entries--;
+
+    cairo_surface_destroy(entry->surface);
+    enif_free(entry);
+}
+
+/**
+ * Evict least recently used entries until the cache fits into limit.
+ * The cache lock must be held.
+ * @brief raster_cache_shrink
+ */
+static void raster_cache_shrink(size_t limit) {
+    while (raster_cache.tail && raster_cache.bytes > limit) {
+        raster_cache_remove(raster_cache.tail);
+    }
+}
+
+static void raster_cache_forget(void *serial);
+
+/**
+ * Get the serial number of a recording surface, assigning one on
+ * first use. When the recording is destroyed its entries are dropped.
+ * @brief recording_serial
+ * @return the serial or 0 if none could be assigned
+ */
+static unsigned long recording_serial(cairo_surface_t *recording) {
+    unsigned long serial = (unsigned long) cairo_surface_get_user_data(recording, &recording_serial_key);
+    if (!serial) {
+        serial = __sync_add_and_fetch(&recording_serial_counter, 1);
+        if (cairo_surface_set_user_data(recording, &recording_serial_key,
+                                        (void *) serial, raster_cache_forget) != CAIRO_STATUS_SUCCESS) {
+            return 0;
+        }
+    }
+    return serial;
+}
+
+/**
+ * Drop the rasterizations of a recording surface that is about to be
+ * drawn to. Removing the serial runs raster_cache_forget, the next
+ * render assigns a new one.
+ * @brief raster_cache_invalidate
+ */
+static void raster_cache_invalidate(cairo_surface_t *surface) {
+    if (cairo_surface_get_type(surface) == CAIRO_SURFACE_TYPE_RECORDING &&
+        cairo_surface_get_user_data(surface, &recording_serial_key)) {
+        cairo_surface_set_user_data(surface, &recording_serial_key, NULL, NULL);
+    }
+}
+
+/**
+ * Look up a rasterization and mark it as most recently used
+ * @brief raster_cache_lookup
+ * @return a new reference to the cached surface or NULL on a miss
+ */
+static cairo_surface_t *raster_cache_lookup(unsigned long serial, const cairo_matrix_t *matrix,
+                                            cairo_format_t format, int width, int height) {
+    cairo_surface_t *surface = NULL;
+
+    enif_mutex_lock(raster_cache.lock);
+    if (raster_cache.max_bytes > 0) {
+        raster_entry_t *entry = raster_cache.buckets[raster_cache_hash(serial, matrix, format, width, height)];
+        while (entry && !(entry->serial == serial && entry->format == format &&
+                          entry->width == width && entry->height == height &&
+                          memcmp(&entry->matrix, matrix, sizeof(cairo_matrix_t)) == 0)) {
+            entry = entry->chain;
+        }
+
+        if (entry) {
+            if (entry != raster_cache.head) {
+                // Move to the front of the list
+                entry->prev->next = entry->next;
+                if (entry->next) entry->next->prev = entry->prev; else raster_cache.tail = entry->prev;
+                entry->prev = NULL;
+                entry->next = raster_cache.head;
+                raster_cache.head->prev = entry;
+                raster_cache.head = entry;
+            }
+            surface = cairo_surface_reference(entry->surface);
+            raster_cache.hits++;
+        } else {
+            raster_cache.misses++;
+        }
+    }
+    enif_mutex_unlock(raster_cache.lock);
+
+    return surface;
+}
+
+/**
+ * Add a rasterization. The cache takes its own reference; the caller
+ * must not draw to the surface afterwards. Entries that are larger
+ * than the whole cache, or were added concurrently, are not stored.
+ * @brief raster_cache_insert
+ */
+static void raster_cache_insert(unsigned long serial, const cairo_matrix_t *matrix,
+                                cairo_format_t format, int width, int height, cairo_surface_t *surface) {
+    size_t bytes = (size_t) cairo_image_surface_get_stride(surface) * height;
+    unsigned bucket = raster_cache_hash(serial, matrix, format, width, height);
+
+    enif_mutex_lock(raster_cache.lock);
+    if (bytes <= raster_cache.max_bytes) {
+        raster_entry_t *entry = raster_cache.buckets[bucket];
+        while (entry && !(entry->serial == serial && entry->format == format &&
+                          entry->width == width && entry->height == height &&
+                          memcmp(&entry->matrix, matrix, sizeof(cairo_matrix_t)) == 0)) {
+            entry = entry->chain;
+        }
+
+        if (!entry && (entry = enif_alloc(sizeof(raster_entry_t)))) {
+            raster_cache_shrink(raster_cache.max_bytes - bytes);
+
+            entry->serial = serial;
+            entry->matrix = *matrix;
+            entry->format = format;
+            entry->width = width;
+            entry->height = height;
+            entry->surface = cairo_surface_reference(surface);
+            entry->bytes = bytes;
+
+            entry->chain = raster_cache.buckets[bucket];
+            raster_cache.buckets[bucket] = entry;
+
+            entry->prev = NULL;
+            entry->next = raster_cache.head;
+            if (raster_cache.head) raster_cache.head->prev = entry; else raster_cache.tail = entry;
+            raster_cache.head = entry;
+
+            raster_cache.bytes += bytes;
+            raster_cache.entries++;
+        }
+    }
+    enif_mutex_unlock(raster_cache.lock);
+}
+
+/**
+ * Destroy function of the serial user data: drops all entries of a
+ * recording surface that is being destroyed
+ * @brief raster_cache_forget
+ */
+static void raster_cache_forget(void *serial) {
+    if (!raster_cache.lock) {
+        return;
+    }
+
+    enif_mutex_lock(raster_cache.lock);
+    raster_entry_t *entry = raster_cache.head;
+    while (entry) {
+        raster_entry_t *next = entry->next;
+        if (entry->serial == (unsigned long) serial) {
+            raster_cache_remove(entry);
+        }
+        entry = next;
+    }
+    enif_mutex_unlock(raster_cache.lock);
+}
+
+/**
+ * Set the size limit of the cache, evicting entries above it
+ * @brief raster_cache_configure
+ */
+static void raster_cache_configure(size_t max_bytes) {
+    enif_mutex_lock(raster_cache.lock);
+    raster_cache.max_bytes = max_bytes;
+    raster_cache_shrink(max_bytes);
+    enif_mutex_unlock(raster_cache.lock);
+}
+
+/**
+ * Drop all entries, keeping the limit and the counters
+ * @brief raster_cache_clear
+ */
+static void raster_cache_clear(void) {
+    enif_mutex_lock(raster_cache.lock);
+    raster_cache_shrink(0);
+    enif_mutex_unlock(raster_cache.lock);
+}
+
+/**
+ * Drop all entries and the mutex. Must be called from the unload
+ * function.
+ * @brief raster_cache_destroy
+ */
+static void raster_cache_destroy(void) {
+    if (!raster_cache.lock) {
+        return;
+    }
+
+    raster_cache_clear();
+    enif_mutex_destroy(raster_cache.lock);
+    raster_cache.lock = NULL;
+}
+
+// --------------------------------------------------------------------------------
+
+#endif // EXCAIRO_RASTER_CACHE_H
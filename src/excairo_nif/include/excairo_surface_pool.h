@@ -0,0 +1,242 @@
+#ifndef EXCAIRO_SURFACE_POOL_H
+#define EXCAIRO_SURFACE_POOL_H
+
+// Image surface pool
+// --------------------------------------------------------------------------------
+
+/**
+ * User data key under which an image surface created for data stores
+ * the pixel buffer it owns. cairo frees the buffer with the surface.
+ * Such surfaces are never pooled.
+ */
+static cairo_user_data_key_t surface_data_key;
+
+/**
+ * Recycled image surfaces of one (format, width, height). A bucket
+ * keeps at most `cap` surfaces; the counters are reported by
+ * `surface_pool_stats`.
+ */
+typedef struct surface_bucket_t {
+    cairo_format_t format;
+    int width;
+    int height;
+    int cap;
+    int count;
+    cairo_surface_t **surfaces;
+    unsigned long hits;
+    unsigned long misses;
+    struct surface_bucket_t *next;
+} surface_bucket_t;
+
+/**
+ * All buckets, guarded by a single mutex. There are only ever a
+ * handful of buckets, so they are kept in a list. Without a bucket
+ * (the default) surfaces of that shape are not pooled.
+ */
+typedef struct {
+    ErlNifMutex *lock;
+    surface_bucket_t *buckets;
+} surface_pool_t;
+
+static surface_pool_t surface_pool;
+
+/**
+ * Create the pool mutex. Must be called from the load function.
+ * @brief surface_pool_init
+ * @return 1 on success, 0 otherwise
+ */
+static int surface_pool_init(void) {
+    surface_pool.buckets = NULL;
+    surface_pool.lock = enif_mutex_create("excairo_surface_pool_lock");
+    return surface_pool.lock != NULL;
+}
+
+/**
+ * Find the bucket for a shape. The pool lock must be held.
+ * @brief surface_pool_find
+ * @return the bucket or NULL if the shape is not pooled
+ */
+static surface_bucket_t *surface_pool_find(cairo_format_t format, int width, int height) {
+    surface_bucket_t *bucket;
+    for (bucket = surface_pool.buckets; bucket; bucket = bucket->next) {
+        if (bucket->format == format && bucket->width == width && bucket->height == height) {
+            return bucket;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Take a surface of the given shape out of the pool. The pixels are
+ * cleared here rather than when the surface is returned, so surfaces
+ * that are never reused are never cleared. Callers that overwrite
+ * every pixel anyway pass clear = 0 and get the old contents.
+ * @brief surface_pool_checkout
+ * @return a surface or NULL if none is available
+ */
+static cairo_surface_t *surface_pool_checkout(cairo_format_t format, int width, int height, int clear) {
+    cairo_surface_t *surface = NULL;
+
+    enif_mutex_lock(surface_pool.lock);
+    surface_bucket_t *bucket = surface_pool_find(format, width, height);
+    if (bucket) {
+        if (bucket->count > 0) {
+            surface = bucket->surfaces[--bucket->count];
+            bucket->hits++;
+        } else {
+            bucket->misses++;
+        }
+    }
+    enif_mutex_unlock(surface_pool.lock);
+
+    if (surface && clear) {
+        cairo_surface_flush(surface);
+        memset(cairo_image_surface_get_data(surface), 0,
+               (size_t) cairo_image_surface_get_stride(surface) * height);
+        cairo_surface_mark_dirty(surface);
+    }
+
+    return surface;
+}
+
+/**
+ * Offer a surface whose resource is being collected to the pool.
+ * Only healthy image surfaces nobody else references, that own the
+ * default buffer cairo allocated for them, are accepted.
+ * @brief surface_pool_checkin
+ * @return 1 if the pool took ownership, 0 if the caller must destroy it
+ */
+static int surface_pool_checkin(cairo_surface_t *surface) {
+    if (!surface_pool.lock ||
+        cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+        cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS ||
+        cairo_surface_get_reference_count(surface) != 1 ||
+        cairo_surface_get_user_data(surface, &surface_data_key)) {
+        return 0;
+    }
+
+    cairo_format_t format = cairo_image_surface_get_format(surface);
+    int width = cairo_image_surface_get_width(surface);
+    int height = cairo_image_surface_get_height(surface);
+    if (cairo_image_surface_get_stride(surface) != cairo_format_stride_for_width(format, width)) {
+        return 0;
+    }
+
+    // Surfaces come out of the pool like new ones, without damage
+    // tracking. Once in the pool another thread can take the surface,
+    // so per-use state is dropped first; rejected surfaces are
+    // destroyed by the caller anyway.
+    damage_enable(surface, 0);
+
+    int taken = 0;
+
+    enif_mutex_lock(surface_pool.lock);
+    surface_bucket_t *bucket = surface_pool_find(format, width, height);
+    if (bucket && bucket->count < bucket->cap) {
+        bucket->surfaces[bucket->count++] = surface;
+        taken = 1;
+    }
+    enif_mutex_unlock(surface_pool.lock);
+
+    return taken;
+}
+
+/**
+ * Set the number of surfaces kept for a shape. A cap of 0 removes the
+ * bucket; surfaces above the new cap are destroyed.
+ * @brief surface_pool_set_cap
+ * @return 1 on success, 0 if memory ran out
+ */
+static int surface_pool_set_cap(cairo_format_t format, int width, int height, int cap) {
+    int result = 1;
+
+    enif_mutex_lock(surface_pool.lock);
+
+    surface_bucket_t **link = &surface_pool.buckets;
+    while (*link && !((*link)->format == format && (*link)->width == width && (*link)->height == height)) {
+        link = &(*link)->next;
+    }
+
+    surface_bucket_t *bucket = *link;
+    if (!bucket && cap > 0) {
+        bucket = enif_alloc(sizeof(surface_bucket_t));
+        if (bucket) {
+            memset(bucket, 0, sizeof(surface_bucket_t));
+            bucket->format = format;
+            bucket->width = width;
+            bucket->height = height;
+            bucket->next = surface_pool.buckets;
+            surface_pool.buckets = bucket;
+            link = &surface_pool.buckets;
+        }
+    }
+
+    if (bucket) {
+        while (bucket->count > cap) {
+            cairo_surface_destroy(bucket->surfaces[--bucket->count]);
+        }
+
+        if (cap == 0) {
+            *link = bucket->next;
+            enif_free(bucket->surfaces);
+            enif_free(bucket);
+        } else {
+            cairo_surface_t **surfaces = enif_realloc(bucket->surfaces, sizeof(cairo_surface_t *) * cap);
+            if (surfaces) {
+                bucket->surfaces = surfaces;
+                bucket->cap = cap;
+            } else {
+                result = 0;
+            }
+        }
+    } else if (cap > 0) {
+        result = 0;
+    }
+
+    enif_mutex_unlock(surface_pool.lock);
+    return result;
+}
+
+/**
+ * Destroy all pooled surfaces, keeping the caps
+ * @brief surface_pool_clear
+ */
+static void surface_pool_clear(void) {
+    enif_mutex_lock(surface_pool.lock);
+
+    surface_bucket_t *bucket;
+    for (bucket = surface_pool.buckets; bucket; bucket = bucket->next) {
+        while (bucket->count > 0) {
+            cairo_surface_destroy(bucket->surfaces[--bucket->count]);
+        }
+    }
+
+    enif_mutex_unlock(surface_pool.lock);
+}
+
+/**
+ * Destroy all pooled surfaces and buckets. Must be called from the
+ * unload function.
+ * @brief surface_pool_destroy
+ */
+static void surface_pool_destroy(void) {
+    if (!surface_pool.lock) {
+        return;
+    }
+
+    surface_pool_clear();
+
+    while (surface_pool.buckets) {
+        surface_bucket_t *bucket = surface_pool.buckets;
+        surface_pool.buckets = bucket->next;
+        enif_free(bucket->surfaces);
+        enif_free(bucket);
+    }
+
+    enif_mutex_destroy(surface_pool.lock);
+    surface_pool.lock = NULL;
+}
+
+// --------------------------------------------------------------------------------
+
+#endif // EXCAIRO_SURFACE_POOL_H
@@ -1,4 +1,632 @@
 defmodule ExcairoTest do
   use ExUnit.Case, async: false
   doctest ExCairo
+
+  # Premultiplied ARGB32 pixels
+  @red   0xFFFF0000
+  @green 0xFF00FF00
+  @blue  0xFF0000FF
+
+  defp new_context(width \\ 16, height \\ 16) do
+    {:ok, surface} = ExCairo.image_surface_create(:argb32, width, height)
+    {:ok, context} = ExCairo.create(surface)
+    {surface, context}
+  end
+
+  defp pixel(surface, x, y, width \\ 16) do
+    offset = (y * width + x) * 4
+    <<_::binary-size(offset), value::native-32, _::binary>> = ExCairo.image_surface_get_data(surface)
+    value
+  end
+
+  test "execute applies a list of operations" do
+    {surface, context} = new_context()
+    ops = [{:set_source_rgb, 1, 0, 0}, {:rectangle, 0, 0, 8, 16}, :fill, {:move_to, 2, 3}]
+    assert :ok == ExCairo.execute(context, ops)
+    assert {2.0, 3.0} == ExCairo.get_current_point(context)
+    assert @red == pixel(surface, 2, 2)
+    assert 0 == pixel(surface, 12, 2)
+  end
+
+  test "execute applies packed operations" do
+    {surface, context} = new_context()
+    ops = <<26, 0.0::float-64, 0.0::float-64, 1.0::float-64,
+            11, 0.0::float-64, 0.0::float-64, 16.0::float-64, 16.0::float-64,
+            14,
+            3, 4.0::float-64, 5.0::float-64>>
+    assert :ok == ExCairo.execute(context, ops)
+    assert {4.0, 5.0} == ExCairo.get_current_point(context)
+    assert @blue == pixel(surface, 8, 8)
+  end
+
+  test "execute stops at the first malformed operation" do
+    {_surface, context} = new_context()
+    assert {:error, 1} == ExCairo.execute(context, [{:move_to, 2, 3}, {:line_to, 1}])
+    assert {2.0, 3.0} == ExCairo.get_current_point(context)
+
+    {_surface, context} = new_context()
+    assert {:error, 1} == ExCairo.execute(context, <<2, 3, 1.0::float-64>>)
+  end
+
+  test "execute reports the operation that put the context in error" do
+    {_surface, context} = new_context()
+    assert {:error, 0} == ExCairo.execute(context, [:restore])
+  end
+
+  test "execute rejects improper lists without drawing" do
+    {_surface, context} = new_context()
+    assert_raise ArgumentError, fn -> ExCairo.execute(context, [{:move_to, 2, 3} | :fill]) end
+    assert {0.0, 0.0} == ExCairo.get_current_point(context)
+  end
+
+  test "execute draws long batches on a dirty scheduler" do
+    {surface, context} = new_context()
+    ops = [{:set_source_rgb, 0, 1, 0} | List.duplicate({:rectangle, 0, 0, 16, 16}, 5000)] ++ [:fill]
+    assert :ok == ExCairo.execute(context, ops)
+    assert @green == pixel(surface, 8, 8)
+  end
+
+  test "large surfaces are filled and written on dirty schedulers" do
+    {surface, context} = new_context(1024, 1024)
+    assert :ok == ExCairo.set_source_rgb(context, 0.0, 1.0, 0.0)
+    assert :ok == ExCairo.execute(context, [{:rectangle, 0, 0, 1024, 1024}])
+    assert :ok == ExCairo.fill(context)
+    assert @green == pixel(surface, 1023, 1023, 1024)
+
+    path = Path.join(System.tmp_dir!, "excairo_dirty_test.png")
+    assert {:ok, 0} == ExCairo.surface_write_to_png(surface, path)
+    {:ok, loaded} = ExCairo.image_surface_create_from_png(path)
+    File.rm(path)
+
+    assert @green == pixel(loaded, 1023, 1023, 1024)
+  end
+
+  test "render_async draws on a worker and reports back" do
+    {surface, context} = new_context()
+    {:ok, ref} = ExCairo.render_async(surface, context, [{:set_source_rgb, 1, 0, 0}, :paint])
+    assert_receive {:excairo_done, ^ref, :ok}, 5000
+    assert @red == pixel(surface, 0, 0)
+  end
+
+  test "render_async rejects a malformed batch right away" do
+    {surface, context} = new_context()
+    assert {:error, 1} == ExCairo.render_async(surface, context, [:paint, {:paint_with_alpha}])
+    refute_receive {:excairo_done, _, _}
+  end
+
+  test "render_async requires the target of the context" do
+    {_surface, context} = new_context()
+    {other, _context} = new_context()
+    assert_raise ArgumentError, fn -> ExCairo.render_async(other, context, [:paint]) end
+  end
+
+  test "display lists are compiled once and replayed many times" do
+    {:ok, list} = ExCairo.display_list_compile([{:set_source_rgb, 1, 0, 0}, {:rectangle, 0, 0, 4, 4}, :fill, {:move_to, 1, 2}])
+
+    {surface, context} = new_context()
+    assert :ok == ExCairo.display_list_replay(context, list)
+    assert {1.0, 2.0} == ExCairo.get_current_point(context)
+    assert :ok == ExCairo.display_list_replay(context, list, {{1, 0}, {0, 1}, {8, 8}})
+    assert {9.0, 10.0} == ExCairo.get_current_point(context)
+    assert @red == pixel(surface, 2, 2)
+    assert @red == pixel(surface, 10, 10)
+    assert 0 == pixel(surface, 6, 6)
+
+    {other, context} = new_context()
+    assert :ok == ExCairo.display_list_replay(context, list)
+    assert @red == pixel(other, 2, 2)
+  end
+
+  test "display list errors point at the failing operation" do
+    assert {:error, 2} == ExCairo.display_list_compile([:new_path, :fill, {:line_to, 1}])
+
+    {:ok, list} = ExCairo.display_list_compile([:save, :restore, :restore])
+    {_surface, context} = new_context()
+    assert {:error, 2} == ExCairo.display_list_replay(context, list)
+  end
+
+  test "polygon closes a shape from packed points" do
+    {surface, context} = new_context()
+    points = <<1.0::float-64, 2.0::float-64, 16.0::float-64, 0.0::float-64,
+               16.0::float-64, 16.0::float-64, 0.0::float-64, 16.0::float-64>>
+    assert :ok == ExCairo.polygon(context, points)
+    assert {1.0, 2.0} == ExCairo.get_current_point(context)
+
+    assert :ok == ExCairo.set_source_rgb(context, 1.0, 0.0, 0.0)
+    assert :ok == ExCairo.fill(context)
+    assert @red == pixel(surface, 8, 8)
+  end
+
+  test "polyline ends at the last of many points" do
+    {_surface, context} = new_context()
+    points = for i <- 0..99_999, into: <<>>, do: <<i * 1.0::float-64, 2.0::float-64>>
+    assert :ok == ExCairo.polyline(context, points)
+    assert {99_999.0, 2.0} == ExCairo.get_current_point(context)
+  end
+
+  test "polyline rejects truncated points" do
+    {_surface, context} = new_context()
+    assert_raise ArgumentError, fn -> ExCairo.polyline(context, <<1.0::float-64>>) end
+  end
+
+  test "polyline keeps the context locked until the last point" do
+    {_surface, context} = new_context()
+    points = for i <- 1..400_000, into: <<>>, do: <<i * 1.0::float-64, 2.0::float-64>>
+    task = Task.async(fn -> ExCairo.polyline(context, points) end)
+
+    seen = Stream.repeatedly(fn -> ExCairo.get_current_point(context) end)
+           |> Enum.take_while(fn _ -> Task.yield(task, 0) == nil end)
+    assert Enum.all?(seen, &(&1 in [{:error, :busy}, {0.0, 0.0}, {400_000.0, 2.0}]))
+    assert {400_000.0, 2.0} == ExCairo.get_current_point(context)
+  end
+
+  test "contexts and surfaces in use report busy" do
+    {surface, context} = new_context(2048, 2048)
+    {:ok, other} = ExCairo.create(surface)
+    ops = [{:set_source_rgb, 1, 0, 0} | List.duplicate(:paint, 100)]
+    path = Path.join(System.tmp_dir!, "excairo_busy_test.png")
+
+    {:ok, ref} = ExCairo.render_async(surface, context, ops)
+    assert {:error, :busy} == ExCairo.paint(context)
+    assert {:error, :busy} == ExCairo.paint(other)
+    assert {:error, :busy} == ExCairo.surface_write_to_png(surface, path)
+
+    assert_receive {:excairo_done, ^ref, :ok}, 30_000
+    assert @red == pixel(surface, 0, 0, 2048)
+    assert :ok == ExCairo.paint(other)
+  end
+
+  test "surfaces are encoded to PNG binaries in memory" do
+    {surface, context} = new_context()
+    assert :ok == ExCairo.execute(context, [{:set_source_rgb, 1, 0, 0}, :paint])
+    {:ok, png} = ExCairo.surface_write_to_png_binary(surface)
+    assert <<137, "PNG", 13, 10, 26, 10, _::binary>> = png
+
+    path = Path.join(System.tmp_dir!, "excairo_binary_test.png")
+    assert {:ok, 0} == ExCairo.surface_write_to_png(surface, path)
+    assert png == File.read!(path)
+    File.rm(path)
+  end
+
+  test "PNG binaries decode back to the same image" do
+    {surface, context} = new_context(1024, 1024)
+    assert :ok == ExCairo.execute(context, [{:set_source_rgb, 0, 0, 1}, {:rectangle, 0, 0, 512, 1024}, :fill])
+    {:ok, png} = ExCairo.surface_write_to_png_binary(surface)
+
+    {:ok, decoded} = ExCairo.image_surface_create_from_png_binary(png)
+    assert {:ok, png} == ExCairo.surface_write_to_png_binary(decoded)
+  end
+
+  test "invalid PNG binaries are reported as errors" do
+    {surface, _context} = new_context()
+    {:ok, png} = ExCairo.surface_write_to_png_binary(surface)
+
+    assert {:error, status} = ExCairo.image_surface_create_from_png_binary("not a png")
+    assert is_integer(status)
+    assert {:error, _} = ExCairo.image_surface_create_from_png_binary(binary_part(png, 0, 40))
+  end
+
+  test "image_surface_get_data exposes the whole pixel buffer" do
+    {surface, context} = new_context()
+    assert 16 * 16 * 4 == byte_size(ExCairo.image_surface_get_data(surface))
+    assert :binary.copy(<<0>>, 1024) == ExCairo.image_surface_get_data(surface)
+
+    assert :ok == ExCairo.execute(context, [{:set_source_rgb, 1, 0, 0}, :paint])
+    assert :binary.copy(<<@red::native-32>>, 256) == ExCairo.image_surface_get_data(surface)
+  end
+
+  test "image surfaces are created from caller pixels" do
+    row = :binary.copy(<<@red::native-32>>, 16) <> :binary.copy(<<0>>, 16)
+    data = :binary.copy(row, 16)
+    {:ok, surface} = ExCairo.image_surface_create_for_data(data, :argb32, 16, 16, 80)
+    assert data == ExCairo.image_surface_get_data(surface)
+    assert @red == pixel(surface, 15, 15, 20)
+
+    {:ok, context} = ExCairo.create(surface)
+    assert :ok == ExCairo.execute(context, [{:set_source_rgb, 0, 0, 1}, :paint])
+    assert @blue == pixel(surface, 0, 0, 20)
+    assert <<@red::native-32, _::binary>> = data
+  end
+
+  test "image_surface_create_for_data checks the stride and the size" do
+    data = :binary.copy(<<0>>, 1024)
+    assert_raise ArgumentError, fn -> ExCairo.image_surface_create_for_data(data, :argb32, 16, 16, 32) end
+    assert_raise ArgumentError, fn -> ExCairo.image_surface_create_for_data(data, :argb32, 16, 17, 64) end
+  end
+
+  defp wait_until(fun, attempts \\ 100) do
+    cond do
+      fun.() -> :ok
+      attempts > 0 ->
+        :timer.sleep(10)
+        wait_until(fun, attempts - 1)
+      true -> flunk "condition not met in time"
+    end
+  end
+
+  test "collected image surfaces are reused through the pool" do
+    assert :ok == ExCairo.surface_pool_set_cap(:argb32, 24, 24, 2)
+    pool = fn -> List.keyfind(ExCairo.surface_pool_stats, 24, 1) end
+
+    spawn(fn ->
+      {surface, context} = new_context(24, 24)
+      :ok = ExCairo.surface_track_damage(surface, true)
+      :ok = ExCairo.execute(context, [{:set_source_rgb, 1, 0, 0}, :paint])
+    end)
+    wait_until(fn -> {:argb32, 24, 24, 2, 1, 0, 1} == pool.() end)
+
+    {surface, _context} = new_context(24, 24)
+    assert {:argb32, 24, 24, 2, 0, 1, 1} == pool.()
+    assert :binary.copy(<<0>>, 24 * 24 * 4) == ExCairo.image_surface_get_data(surface)
+    assert {:error, :not_tracked} == ExCairo.surface_take_damage(surface)
+
+    assert :ok == ExCairo.surface_pool_clear
+    assert :ok == ExCairo.surface_pool_set_cap(:argb32, 24, 24, 0)
+    assert nil == pool.()
+  end
+
+  defp red_recording(size) do
+    {:ok, recording} = ExCairo.recording_surface_create(:color_alpha, {0.0, 0.0, size * 1.0, size * 1.0})
+    {:ok, context} = ExCairo.create(recording)
+    :ok = ExCairo.execute(context, [{:set_source_rgb, 1, 0, 0}, :paint])
+    recording
+  end
+
+  test "recordings are rendered into a tile pyramid" do
+    recording = red_recording(256)
+    {:ok, tiles} = ExCairo.recording_surface_render_tiles(recording, 64, 0, 1)
+    assert [{0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {1, 1, 0}, {1, 1, 1}] ==
+             tiles |> Enum.map(fn {z, x, y, _png} -> {z, x, y} end) |> Enum.sort
+
+    {0, 0, 0, png} = List.keyfind(tiles, 0, 0)
+    {:ok, tile} = ExCairo.image_surface_create_from_png_binary(png)
+    assert @red == pixel(tile, 63, 63, 64)
+  end
+
+  test "tiles are streamed to a process" do
+    recording = red_recording(256)
+    {:ok, ref} = ExCairo.recording_surface_render_tiles(recording, 64, 1, 1, self())
+    for _ <- 1..4, do: assert_receive {:excairo_tile, ^ref, {1, _, _}, <<137, "PNG", _::binary>>}, 5000
+    assert_receive {:excairo_tiles_done, ^ref, :ok}, 5000
+  end
+
+  test "tile pyramids are bounded" do
+    recording = red_recording(256)
+    assert_raise ArgumentError, fn -> ExCairo.recording_surface_render_tiles(recording, 64, 0, 21) end
+    assert_raise ArgumentError, fn -> ExCairo.recording_surface_render_tiles(recording, 1, 0, 9) end
+  end
+
+  test "display lists are rendered in parallel bands" do
+    {:ok, list} = ExCairo.display_list_compile([{:set_source_rgb, 1, 0, 0}, {:rectangle, 0, 0, 64, 128}, :fill])
+    {:ok, surface} = ExCairo.render_bands(list, :argb32, 64, 1024)
+    assert @red == pixel(surface, 0, 0, 64)
+    assert @red == pixel(surface, 63, 127, 64)
+    assert 0 == pixel(surface, 0, 128, 64)
+    assert 0 == pixel(surface, 63, 1023, 64)
+  end
+
+  test "recordings are rendered in parallel bands" do
+    {:ok, surface} = ExCairo.render_bands(red_recording(256), :argb32, 256, 512)
+    assert @red == pixel(surface, 255, 255, 256)
+    assert 0 == pixel(surface, 0, 256, 256)
+  end
+
+  test "band and tile workers replay what was last drawn into a recording" do
+    {:ok, recording} = ExCairo.recording_surface_create(:color_alpha, {0.0, 0.0, 256.0, 256.0})
+    {:ok, context} = ExCairo.create(recording)
+    :ok = ExCairo.execute(context, [{:set_source_rgb, 1, 0, 0}, :paint])
+    {:ok, surface} = ExCairo.render_bands(recording, :argb32, 256, 256)
+    assert @red == pixel(surface, 0, 0, 256)
+
+    :ok = ExCairo.execute(context, [{:set_source_rgb, 0, 0, 1}, {:rectangle, 0, 0, 128, 256}, :fill])
+    {:ok, surface} = ExCairo.render_bands(recording, :argb32, 256, 256)
+    assert @blue == pixel(surface, 0, 255, 256)
+    assert @red == pixel(surface, 255, 255, 256)
+
+    {:ok, [{0, 0, 0, png}]} = ExCairo.recording_surface_render_tiles(recording, 256, 0, 0)
+    {:ok, tile} = ExCairo.image_surface_create_from_png_binary(png)
+    assert @blue == pixel(tile, 0, 0, 256)
+    assert @red == pixel(tile, 255, 0, 256)
+  end
+
+  test "band rendering reports the failing operation" do
+    {:ok, list} = ExCairo.display_list_compile([:restore])
+    assert {:error, {:op, 0}} == ExCairo.render_bands(list, :argb32, 64, 64)
+  end
+
+  test "recording replays are served from the raster cache" do
+    assert :ok == ExCairo.raster_cache_configure(1024 * 1024)
+    assert :ok == ExCairo.raster_cache_clear
+    {0, 0, _, hits, misses} = ExCairo.raster_cache_stats
+
+    recording = red_recording(32)
+    identity = {{1, 0}, {0, 1}, {0, 0}}
+    {:ok, first} = ExCairo.raster_cache_render(recording, identity, :argb32, 32, 32)
+    assert {1, 4096, 1_048_576, ^hits, _} = ExCairo.raster_cache_stats
+    assert @red == pixel(first, 0, 0, 32)
+
+    {:ok, context} = ExCairo.create(first)
+    assert :ok == ExCairo.execute(context, [{:set_source_rgb, 0, 0, 1}, :paint])
+
+    {:ok, second} = ExCairo.raster_cache_render(recording, identity, :argb32, 32, 32)
+    assert {1, _, _, new_hits, new_misses} = ExCairo.raster_cache_stats
+    assert {hits + 1, misses + 1} == {new_hits, new_misses}
+    assert @red == pixel(second, 0, 0, 32)
+
+    assert :ok == ExCairo.raster_cache_configure(0)
+    assert {0, 0, 0, _, _} = ExCairo.raster_cache_stats
+  end
+
+  test "drawing into a recording drops its cached rasterizations" do
+    assert :ok == ExCairo.raster_cache_configure(1024 * 1024)
+    identity = {{1, 0}, {0, 1}, {0, 0}}
+
+    {:ok, recording} = ExCairo.recording_surface_create(:color_alpha, {0.0, 0.0, 32.0, 32.0})
+    {:ok, context} = ExCairo.create(recording)
+    :ok = ExCairo.execute(context, [{:set_source_rgb, 1, 0, 0}, :paint])
+    {:ok, first} = ExCairo.raster_cache_render(recording, identity, :argb32, 32, 32)
+    assert @red == pixel(first, 0, 0, 32)
+
+    :ok = ExCairo.execute(context, [{:set_source_rgb, 0, 0, 1}, :paint])
+    {:ok, second} = ExCairo.raster_cache_render(recording, identity, :argb32, 32, 32)
+    assert @blue == pixel(second, 0, 0, 32)
+    assert {1, _, _, _, _} = ExCairo.raster_cache_stats
+
+    assert :ok == ExCairo.raster_cache_configure(0)
+  end
+
+  defp font_context do
+    {surface, context} = new_context(64, 16)
+    :ok = ExCairo.select_font_face(context, "sans", :normal, :normal)
+    :ok = ExCairo.set_font_size(context, 12.0)
+    {surface, context}
+  end
+
+  test "text is converted to packed glyphs of a scaled font" do
+    {_surface, context} = font_context()
+    {:ok, font} = ExCairo.get_scaled_font(context)
+    {:ok, glyphs} = ExCairo.text_to_glyphs(font, 2, 12, "Hi")
+    assert 2 * 20 == byte_size(glyphs)
+    assert <<_index::32, 2.0::float-64, 12.0::float-64, _::binary>> = glyphs
+
+    {_surface, other} = new_context(64, 16)
+    assert :ok == ExCairo.set_scaled_font(other, font)
+    assert :ok == ExCairo.show_glyphs(other, glyphs)
+    assert :ok == ExCairo.show_glyphs(other, glyphs)
+  end
+
+  test "show_glyphs rejects truncated glyphs" do
+    {_surface, context} = font_context()
+    assert_raise ArgumentError, fn -> ExCairo.show_glyphs(context, <<1::32, 2.0::float-64>>) end
+  end
+
+  test "text_extents_many measures every string in one call" do
+    {_surface, context} = font_context()
+    {:ok, font} = ExCairo.get_scaled_font(context)
+    texts = ["i", "ii", ""]
+
+    extents = ExCairo.text_extents_many(context, texts)
+    assert extents == ExCairo.text_extents_many(font, texts)
+    assert <<_::binary-size(32), one::float-64, _::float-64,
+             _::binary-size(32), two::float-64, _::float-64,
+             _::binary-size(16), 0.0::float-64, _::float-64, 0.0::float-64, _::float-64>> = extents
+    assert_in_delta 2 * one, two, 0.001
+    assert <<>> == ExCairo.text_extents_many(context, [])
+  end
+
+  test "text_extents_many reports strings that can't be shaped" do
+    {_surface, context} = font_context()
+    # 8 is CAIRO_STATUS_INVALID_STRING
+    assert {:error, {1, 8}} == ExCairo.text_extents_many(context, ["i", <<0xFF, 0xFE>>, "i"])
+    assert <<_::binary-size(48)>> = ExCairo.text_extents_many(context, ["i"])
+  end
+
+  test "show_text draws short and long strings" do
+    {_surface, context} = font_context()
+    assert :ok == ExCairo.show_text(context, "Hello")
+    assert :ok == ExCairo.show_text(context, String.duplicate("long text ", 8_000))
+  end
+
+  test "show_text reports invalid UTF-8" do
+    {_surface, context} = font_context()
+    assert {:error, _status} = ExCairo.show_text(context, <<0xFF, 0xFE>>)
+
+    {_surface, context} = font_context()
+    assert {:error, _status} = ExCairo.show_text(context, String.duplicate("a", 70_000) <> <<0xFF>>)
+  end
+
+  test "paths are exported and imported as packed binaries" do
+    {_surface, context} = new_context()
+    :ok = ExCairo.execute(context, [{:move_to, 1, 2}, {:line_to, 3, 4}, :close_path])
+    {:ok, path} = ExCairo.copy_path(context)
+    packed = ExCairo.path_to_binary(path)
+    assert <<0, 1.0::float-64, 2.0::float-64,
+             1, 3.0::float-64, 4.0::float-64,
+             3, _::binary>> = packed
+
+    {_surface, other} = new_context()
+    assert :ok == ExCairo.append_path_binary(other, packed)
+    {:ok, copy} = ExCairo.copy_path(other)
+    assert packed == ExCairo.path_to_binary(copy)
+  end
+
+  test "append_path_binary rejects malformed paths as a whole" do
+    {_surface, context} = new_context()
+    assert {:error, 17} == ExCairo.append_path_binary(context, <<0, 1.0::float-64, 2.0::float-64, 1, 3.0::float-64>>)
+    assert {:error, 0} == ExCairo.append_path_binary(context, <<9>>)
+    {:ok, path} = ExCairo.copy_path(context)
+    assert <<>> == ExCairo.path_to_binary(path)
+  end
+
+  test "copied paths are appended with a transform" do
+    {_surface, context} = new_context()
+    :ok = ExCairo.execute(context, [{:move_to, 0, 0}, {:line_to, 2, 3}])
+    {:ok, path} = ExCairo.copy_path(context)
+
+    {_surface, other} = new_context()
+    assert :ok == ExCairo.append_path(other, path)
+    assert {2.0, 3.0} == ExCairo.get_current_point(other)
+    assert :ok == ExCairo.append_path(other, path, {10, 20})
+    assert {12.0, 23.0} == ExCairo.get_current_point(other)
+    assert :ok == ExCairo.append_path(other, path, {{2, 0}, {0, 2}, {1, 1}})
+    assert {5.0, 7.0} == ExCairo.get_current_point(other)
+  end
+
+  test "matrix resources are composed in place" do
+    {:ok, matrix} = ExCairo.matrix_init_identity
+    assert :ok == ExCairo.matrix_translate(matrix, 1, 2)
+    assert :ok == ExCairo.matrix_scale(matrix, 2, 2)
+    assert {3.0, 4.0} == ExCairo.matrix_transform_point(matrix, 1, 1)
+    assert {2.0, 2.0} == ExCairo.matrix_transform_distance(matrix, 1, 1)
+
+    assert :ok == ExCairo.matrix_multiply(matrix, {{1, 0}, {0, 1}, {10, 0}})
+    assert {{2.0, 0.0}, {0.0, 2.0}, {11.0, 2.0}} == ExCairo.matrix_to_tuple(matrix)
+
+    assert :ok == ExCairo.matrix_invert(matrix)
+    assert {1.0, 1.0} == ExCairo.matrix_transform_point(matrix, 13, 4)
+  end
+
+  test "matrices transform packed points in one call" do
+    {:ok, matrix} = ExCairo.matrix_init(2, 0, 0, 3, 1, 1)
+    points = <<1.0::float-64, 1.0::float-64, -1.0::float-64, 0.0::float-64>>
+    assert <<3.0::float-64, 4.0::float-64, -1.0::float-64, 1.0::float-64>> ==
+             ExCairo.matrix_transform_points(matrix, points)
+    assert <<>> == ExCairo.matrix_transform_points(matrix, <<>>)
+    assert_raise ArgumentError, fn -> ExCairo.matrix_transform_points(matrix, <<1.0::float-64>>) end
+  end
+
+  test "singular matrices are not inverted" do
+    {:ok, matrix} = ExCairo.matrix_init_scale(0, 1)
+    assert {:error, :invalid_matrix} == ExCairo.matrix_invert(matrix)
+  end
+
+  test "matrix resources are accepted as path transforms" do
+    {_surface, context} = new_context()
+    :ok = ExCairo.execute(context, [{:move_to, 0, 0}, {:line_to, 2, 3}])
+    {:ok, path} = ExCairo.copy_path(context)
+
+    {:ok, matrix} = ExCairo.matrix_init_scale(-1, 1)
+    assert :ok == ExCairo.append_path(context, path, matrix)
+    assert {-2.0, 3.0} == ExCairo.get_current_point(context)
+  end
+
+  test "points are hit tested in batches" do
+    {_surface, context} = new_context()
+    :ok = ExCairo.execute(context, [{:rectangle, 0, 0, 10, 10}, {:set_line_width, 2}])
+    points = <<5.0::float-64, 5.0::float-64, 15.0::float-64, 15.0::float-64, 10.5::float-64, 5.0::float-64>>
+    assert <<0b10000000>> == ExCairo.in_fill_many(context, points)
+    assert <<0b00100000>> == ExCairo.in_stroke_many(context, points)
+    assert <<0b11100000>> == ExCairo.in_clip_many(context, points)
+    assert <<>> == ExCairo.in_fill_many(context, <<>>)
+  end
+
+  test "large hit test batches cover every point" do
+    {_surface, context} = new_context()
+    :ok = ExCairo.execute(context, [{:rectangle, 0, 0, 16, 16}])
+    inside = :binary.copy(<<8.0::float-64, 8.0::float-64>>, 20_000)
+    outside = <<20.0::float-64, 20.0::float-64>>
+    assert :binary.copy(<<0xFF>>, 2_500) <> <<0>> == ExCairo.in_fill_many(context, inside <> outside)
+    assert {:ok, _path} = ExCairo.copy_path(context)
+  end
+
+  defp rect(x, y, width, height) do
+    <<x::32-signed, y::32-signed, width::32-signed, height::32-signed>>
+  end
+
+  test "regions are built from packed rectangles" do
+    {:ok, region} = ExCairo.region_create_rectangles(rect(0, 0, 10, 10) <> rect(20, 0, 10, 10))
+    assert 2 == ExCairo.region_num_rectangles(region)
+    assert {0, 0, 30, 10} == ExCairo.region_get_extents(region)
+    assert rect(0, 0, 10, 10) <> rect(20, 0, 10, 10) == ExCairo.region_get_rectangles(region)
+    assert ExCairo.region_contains_point(region, 5, 5)
+    refute ExCairo.region_contains_point(region, 15, 5)
+    assert :in == ExCairo.region_contains_rectangle(region, {1, 1, 2, 2})
+    assert :out == ExCairo.region_contains_rectangle(region, {12, 0, 4, 4})
+    assert :part == ExCairo.region_contains_rectangle(region, {5, 5, 10, 2})
+
+    {:ok, empty} = ExCairo.region_create
+    assert ExCairo.region_is_empty(empty)
+    refute ExCairo.region_is_empty(region)
+  end
+
+  test "region set operations work in place" do
+    {:ok, region} = ExCairo.region_create_rectangles(rect(0, 0, 10, 10))
+    {:ok, copy} = ExCairo.region_copy(region)
+
+    assert :ok == ExCairo.region_union(region, rect(10, 0, 10, 10))
+    assert {0, 0, 20, 10} == ExCairo.region_get_extents(region)
+    assert :ok == ExCairo.region_subtract(region, copy)
+    assert rect(10, 0, 10, 10) == ExCairo.region_get_rectangles(region)
+    assert :ok == ExCairo.region_xor(region, rect(15, 0, 10, 10))
+    assert rect(10, 0, 5, 10) <> rect(20, 0, 5, 10) == ExCairo.region_get_rectangles(region)
+    assert :ok == ExCairo.region_intersect(region, rect(0, 0, 12, 10))
+    assert rect(10, 0, 2, 10) == ExCairo.region_get_rectangles(region)
+
+    assert :ok == ExCairo.region_translate(copy, 10, 0)
+    assert :ok == ExCairo.region_intersect(copy, region)
+    assert ExCairo.region_equal(copy, region)
+    refute ExCairo.region_is_empty(copy)
+  end
+
+  test "surfaces track the area drawn to" do
+    {surface, context} = new_context()
+    assert {:error, :not_tracked} == ExCairo.surface_take_damage(surface)
+    assert :ok == ExCairo.surface_track_damage(surface, true)
+
+    :ok = ExCairo.execute(context, [{:rectangle, 2, 2, 4, 4}])
+    assert :ok == ExCairo.fill(context)
+    {:ok, damage} = ExCairo.surface_take_damage(surface)
+    assert {2, 2, 4, 4} == ExCairo.region_get_extents(damage)
+
+    {:ok, damage} = ExCairo.surface_take_damage(surface)
+    assert ExCairo.region_is_empty(damage)
+
+    assert :ok == ExCairo.surface_mark_dirty_rectangle(surface, 8, 8, 2, 2)
+    {:ok, damage} = ExCairo.surface_take_damage(surface)
+    assert rect(8, 8, 2, 2) == ExCairo.region_get_rectangles(damage)
+
+    assert :ok == ExCairo.surface_track_damage(surface, false)
+    assert {:error, :not_tracked} == ExCairo.surface_take_damage(surface)
+  end
+
+  test "only tiles that changed since the snapshot are returned" do
+    {surface, context} = new_context(32, 32)
+    {:ok, previous} = ExCairo.surface_snapshot(surface)
+    :ok = ExCairo.execute(context, [{:set_source_rgb, 1, 0, 0}, {:rectangle, 20, 4, 4, 4}, :fill])
+
+    assert {:ok, [{16, 0, 16, 16, data}]} = ExCairo.surface_diff_tiles(surface, previous, 16, :raw)
+    assert 16 * 16 * 4 == byte_size(data)
+    assert <<_::binary-size(272), @red::native-32, _::binary>> = data
+    assert {:ok, []} == ExCairo.surface_diff_tiles(surface, previous, 16, :raw)
+
+    :ok = ExCairo.execute(context, [{:rectangle, 0, 20, 4, 4}, :fill])
+    assert {:ok, [{0, 16, 16, 16, <<137, "PNG", _::binary>>}]} =
+             ExCairo.surface_diff_tiles(surface, previous, 16, :png)
+  end
+
+  test "surface_diff_tiles needs a snapshot of the same size" do
+    {surface, _context} = new_context(32, 32)
+    {other, _context} = new_context()
+    {:ok, previous} = ExCairo.surface_snapshot(other)
+    assert_raise ArgumentError, fn -> ExCairo.surface_diff_tiles(surface, previous, 16, :raw) end
+  end
+
+  test "PNG output is streamed to a process in chunks" do
+    {surface, context} = new_context(512, 512)
+    :ok = ExCairo.execute(context, [{:set_source_rgb, 1, 0, 0}, {:arc, 256, 256, 200, 0, 6.3}, :fill])
+    {:ok, png} = ExCairo.surface_write_to_png_binary(surface)
+
+    ref = make_ref()
+    assert :ok == ExCairo.surface_stream_png(surface, self(), ref)
+    assert png == receive_png(ref, "")
+  end
+
+  defp receive_png(ref, acc) do
+    receive do
+      {:excairo_png_chunk, ^ref, chunk} -> receive_png(ref, acc <> chunk)
+      {:excairo_png_done, ^ref, :ok} -> acc
+    after
+      5000 -> flunk "PNG stream did not finish"
+    end
+  end
 end